@@ -0,0 +1,301 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This header file defines `Future` & `Promise`, a value passed once from a
+// producer to a consumer in another thread, e.g. the result of a task run by a
+// `WorkStealingPool`, with continuations to go on without blocking.
+//
+// An exception thrown by the producer or a continuation is passed on instead
+// of the value, and rethrown by `Get()`. A promise destroyed without setting
+// anything sets a `std::future_error` of `broken_promise`.
+
+#pragma once
+
+#include <cassert>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "one/base/small_function.h"
+
+namespace hcoona {
+
+template <typename T>
+class Future;
+
+template <typename T>
+class Promise;
+
+namespace details {
+
+// `void` is passed around as a `std::monostate`.
+template <typename T>
+using FutureValue =
+    std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+// Either the value, or the exception thrown instead, told apart by index.
+template <typename T>
+using FutureResult = std::variant<FutureValue<T>, std::exception_ptr>;
+
+template <typename T>
+class FutureState {
+ public:
+  using Result = FutureResult<T>;
+
+  // Set once, by the promise only.
+  void SetResult(Result result) {
+    SmallFunction<void(Result)> continuation;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      assert(!satisfied_);
+      satisfied_ = true;
+      if (!continuation_) {
+        result_.emplace(std::move(result));
+        ready_cv_.notify_all();
+        return;
+      }
+      continuation = std::move(continuation_);
+    }
+    // Out of the lock, the continuation may take long.
+    continuation(std::move(result));
+  }
+
+  // Runs at once in this thread if the result is set, otherwise in the thread
+  // setting it.
+  void SetContinuation(SmallFunction<void(Result)> continuation) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    assert(!continuation_);
+    if (!result_.has_value()) {
+      continuation_ = std::move(continuation);
+      return;
+    }
+    lock.unlock();
+    continuation(std::move(*result_));
+  }
+
+  // Rethrows the exception set instead of the value.
+  FutureValue<T> Get() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_cv_.wait(lock, [this] { return result_.has_value(); });
+    if (result_->index() == 1) {
+      std::rethrow_exception(std::get<1>(*result_));
+    }
+    return std::get<0>(std::move(*result_));
+  }
+
+  bool ready() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return result_.has_value();
+  }
+
+  // Only the promise sets it, no lock needed.
+  bool satisfied() const { return satisfied_; }
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable ready_cv_;
+  bool satisfied_{false};
+  std::optional<Result> result_;
+  SmallFunction<void(Result)> continuation_;
+};
+
+// Calls `f` with the value, or with nothing for `void`.
+template <typename T, typename F>
+decltype(auto) InvokeWith(F& f, FutureValue<T>&& value) {
+  if constexpr (std::is_void_v<T>) {
+    (void)value;
+    return f();
+  } else {
+    return f(std::move(value));
+  }
+}
+
+template <typename T, typename F>
+struct ContinuationResult {
+  using type = std::invoke_result_t<F&, T>;
+};
+
+template <typename F>
+struct ContinuationResult<void, F> {
+  using type = std::invoke_result_t<F&>;
+};
+
+// Sets the result of `f` to the promise, or passes on the exception instead
+// of calling `f`.
+template <typename T, typename R, typename F>
+void Fulfill(Promise<R>* promise, F& f, FutureResult<T>&& result) {
+  if (result.index() == 1) {
+    promise->SetException(std::get<1>(std::move(result)));
+    return;
+  }
+  // Set out of the try block, the continuations of `promise` may run then.
+  std::optional<FutureValue<R>> value;
+  try {
+    if constexpr (std::is_void_v<R>) {
+      InvokeWith<T>(f, std::get<0>(std::move(result)));
+      value.emplace();
+    } else {
+      value.emplace(InvokeWith<T>(f, std::get<0>(std::move(result))));
+    }
+  } catch (...) {
+    promise->SetException(std::current_exception());
+    return;
+  }
+  if constexpr (std::is_void_v<R>) {
+    promise->SetValue();
+  } else {
+    promise->SetValue(std::move(*value));
+  }
+}
+
+}  // namespace details
+
+// The producer side, set the value or the exception once. It breaks the
+// promise if it's destroyed without setting either.
+template <typename T>
+class Promise {
+ public:
+  Promise() : state_(std::make_shared<details::FutureState<T>>()) {}
+  ~Promise() { Break(); }
+
+  // Disallow copy.
+  Promise(const Promise&) noexcept = delete;
+  Promise& operator=(const Promise&) noexcept = delete;
+
+  // Allow move.
+  Promise(Promise&&) noexcept = default;
+  Promise& operator=(Promise&& other) noexcept {
+    if (this != &other) {
+      Break();
+      state_ = std::move(other.state_);
+    }
+    return *this;
+  }
+
+  // Call it once.
+  Future<T> GetFuture() { return Future<T>(state_); }
+
+  template <typename U = T, typename = std::enable_if_t<!std::is_void_v<U>>>
+  void SetValue(U value) {
+    state_->SetResult(details::FutureResult<T>(std::in_place_index<0>,
+                                               std::move(value)));
+  }
+
+  template <typename U = T, typename = std::enable_if_t<std::is_void_v<U>>>
+  void SetValue() {
+    state_->SetResult(details::FutureResult<T>(std::in_place_index<0>));
+  }
+
+  void SetException(std::exception_ptr exception) {
+    state_->SetResult(details::FutureResult<T>(std::in_place_index<1>,
+                                               std::move(exception)));
+  }
+
+ private:
+  void Break() {
+    if (state_ != nullptr && !state_->satisfied()) {
+      SetException(std::make_exception_ptr(
+          std::future_error(std::future_errc::broken_promise)));
+    }
+  }
+
+  std::shared_ptr<details::FutureState<T>> state_;
+};
+
+// The consumer side, either get the value, or go on with a continuation.
+template <typename T>
+class Future {
+ public:
+  Future() = default;
+  ~Future() = default;
+
+  // Disallow copy.
+  Future(const Future&) noexcept = delete;
+  Future& operator=(const Future&) noexcept = delete;
+
+  // Allow move.
+  Future(Future&&) noexcept = default;
+  Future& operator=(Future&&) noexcept = default;
+
+  [[nodiscard]] bool valid() const { return state_ != nullptr; }
+
+  [[nodiscard]] bool ready() const { return state_->ready(); }
+
+  // Blocks until the value is set, never call it in an event loop thread.
+  // Rethrows the exception set instead.
+  T Get() {
+    auto state = std::move(state_);
+    if constexpr (std::is_void_v<T>) {
+      state->Get();
+    } else {
+      return state->Get();
+    }
+  }
+
+  // Runs `f(value)` in the thread setting the value, or at once in this thread
+  // if it's set already. Returns the future of its result, which gets the
+  // exception instead if one is set, or thrown by `f`.
+  template <typename F>
+  auto Then(F&& f) {
+    using R = typename details::ContinuationResult<T, std::decay_t<F>>::type;
+    Promise<R> promise;
+    Future<R> future = promise.GetFuture();
+    auto state = std::move(state_);
+    state->SetContinuation(
+        [promise = std::move(promise), f = std::forward<F>(f)](
+            details::FutureResult<T> result) mutable {
+          details::Fulfill<T>(&promise, f, std::move(result));
+        });
+    return future;
+  }
+
+  // Runs `f(value)` by `executor(task)` instead, e.g. back in an event loop
+  // with `[loop](auto task) { loop->RunInLoop(std::move(task)); }`.
+  template <typename Executor, typename F>
+  auto Then(Executor&& executor, F&& f) {
+    using R = typename details::ContinuationResult<T, std::decay_t<F>>::type;
+    Promise<R> promise;
+    Future<R> future = promise.GetFuture();
+    auto state = std::move(state_);
+    state->SetContinuation(
+        [executor = std::forward<Executor>(executor),
+         promise = std::move(promise),
+         f = std::forward<F>(f)](details::FutureResult<T> result) mutable {
+          executor([promise = std::move(promise), f = std::move(f),
+                    result = std::move(result)]() mutable {
+            details::Fulfill<T>(&promise, f, std::move(result));
+          });
+        });
+    return future;
+  }
+
+ private:
+  friend class Promise<T>;
+
+  explicit Future(std::shared_ptr<details::FutureState<T>> state)
+      : state_(std::move(state)) {}
+
+  std::shared_ptr<details::FutureState<T>> state_;
+};
+
+}  // namespace hcoona
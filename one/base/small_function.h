@@ -0,0 +1,189 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This header file defines `SmallFunction`, a move-only `std::function` with a
+// larger inline storage.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace hcoona {
+
+namespace details {
+
+template <typename T>
+constexpr bool kIsStdFunction = false;
+
+template <typename Signature>
+constexpr bool kIsStdFunction<std::function<Signature>> = true;
+
+}  // namespace details
+
+template <typename Signature, size_t kInlineSize = 64>
+class SmallFunction;
+
+// A move-only polymorphic callable wrapper.
+//
+// Unlike `std::function`, which stores at most 16 bytes inline with
+// libstdc++, it keeps callables up to `kInlineSize` bytes inline, e.g. an
+// `absl::bind_front()` result capturing a `std::shared_ptr` & a
+// `std::string`. Larger callables, or the ones which may throw when moving,
+// are allocated on the heap.
+//
+// Being move-only, it could also hold move-only callables, e.g. lambdas
+// capturing a `std::unique_ptr`.
+template <typename R, typename... Args, size_t kInlineSize>
+class SmallFunction<R(Args...), kInlineSize> {
+ public:
+  SmallFunction() noexcept = default;
+
+  SmallFunction(std::nullptr_t) noexcept {}  // NOLINT(runtime/explicit)
+
+  template <typename F,
+            typename = std::enable_if_t<
+                !std::is_same_v<std::decay_t<F>, SmallFunction> &&
+                std::is_invocable_r_v<R, std::decay_t<F>&, Args...>>>
+  SmallFunction(F&& f) {  // NOLINT(runtime/explicit)
+    using Callable = std::decay_t<F>;
+    // Keep empty for null function pointers & empty `std::function`s.
+    if constexpr (std::is_pointer_v<std::remove_reference_t<F>> ||
+                  std::is_member_pointer_v<Callable>) {
+      if (f == nullptr) {
+        return;
+      }
+    } else if constexpr (details::kIsStdFunction<Callable>) {
+      if (!f) {
+        return;
+      }
+    }
+    if constexpr (kStoredInline<Callable>) {
+      ::new (static_cast<void*>(&storage_)) Callable(std::forward<F>(f));
+      ops_ = &kInlineOps<Callable>;
+    } else {
+      ::new (static_cast<void*>(&storage_)) Callable*(
+          new Callable(std::forward<F>(f)));
+      ops_ = &kHeapOps<Callable>;
+    }
+  }
+
+  ~SmallFunction() { Reset(); }
+
+  // Disallow copy.
+  SmallFunction(const SmallFunction&) noexcept = delete;
+  SmallFunction& operator=(const SmallFunction&) noexcept = delete;
+
+  // Allow move.
+  SmallFunction(SmallFunction&& other) noexcept { MoveFrom(&other); }
+  SmallFunction& operator=(SmallFunction&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+
+  SmallFunction& operator=(std::nullptr_t) noexcept {
+    Reset();
+    return *this;
+  }
+
+  explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+  R operator()(Args... args) const {
+    if (ops_ == nullptr) {
+      throw std::bad_function_call();
+    }
+    return ops_->invoke(const_cast<void*>(static_cast<const void*>(&storage_)),
+                        std::forward<Args>(args)...);
+  }
+
+ private:
+  struct Ops {
+    R (*invoke)(void* storage, Args&&... args);
+    // Move-constructs `dst` from `src`, then destroys `src`.
+    void (*relocate)(void* dst, void* src) noexcept;
+    void (*destroy)(void* storage) noexcept;
+  };
+
+  template <typename Callable>
+  static constexpr bool kStoredInline =
+      sizeof(Callable) <= kInlineSize &&
+      alignof(Callable) <= alignof(std::max_align_t) &&
+      std::is_nothrow_move_constructible_v<Callable>;
+
+  template <typename Callable>
+  static R Invoke(Callable* callable, Args&&... args) {
+    if constexpr (std::is_void_v<R>) {
+      std::invoke(*callable, std::forward<Args>(args)...);
+    } else {
+      return std::invoke(*callable, std::forward<Args>(args)...);
+    }
+  }
+
+  template <typename Callable>
+  static constexpr Ops kInlineOps{
+      [](void* storage, Args&&... args) -> R {
+        return Invoke(static_cast<Callable*>(storage),
+                      std::forward<Args>(args)...);
+      },
+      [](void* dst, void* src) noexcept {
+        auto* callable = static_cast<Callable*>(src);
+        ::new (dst) Callable(std::move(*callable));
+        callable->~Callable();
+      },
+      [](void* storage) noexcept {
+        static_cast<Callable*>(storage)->~Callable();
+      },
+  };
+
+  template <typename Callable>
+  static constexpr Ops kHeapOps{
+      [](void* storage, Args&&... args) -> R {
+        return Invoke(*static_cast<Callable**>(storage),
+                      std::forward<Args>(args)...);
+      },
+      [](void* dst, void* src) noexcept {
+        ::new (dst) Callable*(*static_cast<Callable**>(src));
+      },
+      [](void* storage) noexcept { delete *static_cast<Callable**>(storage); },
+  };
+
+  void MoveFrom(SmallFunction* other) noexcept {
+    if (other->ops_ != nullptr) {
+      other->ops_->relocate(&storage_, &other->storage_);
+      ops_ = other->ops_;
+      other->ops_ = nullptr;
+    }
+  }
+
+  void Reset() noexcept {
+    if (ops_ != nullptr) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+  const Ops* ops_{nullptr};
+};
+
+}  // namespace hcoona
@@ -0,0 +1,134 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// Compares the allocations per queued task of `std::function` and
+// `SmallFunction`, with the captures typical for `EventLoop::QueueInLoop()`.
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/functional/bind_front.h"
+#include "benchmark/benchmark.h"
+#include "one/base/small_function.h"
+
+namespace {
+
+std::atomic<int64_t> allocations{0};
+
+}  // namespace
+
+// Out-of-line to keep the compiler from matching the malloc/free inside against
+// the new/delete outside.
+ABSL_ATTRIBUTE_NOINLINE void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* p = std::malloc(size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+ABSL_ATTRIBUTE_NOINLINE void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+ABSL_ATTRIBUTE_NOINLINE void operator delete(void* p,
+                                             size_t /*size*/) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+struct Connection {
+  void Send(const std::string& message) {
+    benchmark::DoNotOptimize(message.data());
+  }
+  void HandleWrite() { benchmark::DoNotOptimize(this); }
+};
+
+// Queues & runs `kBatch` tasks made by `make_task` per iteration, like the
+// pending functors of an event loop.
+template <typename Functor, typename MakeTask>
+void RunTasks(benchmark::State& state, MakeTask make_task) {
+  static constexpr int kBatch = 64;
+  std::vector<Functor> tasks;
+  tasks.reserve(kBatch);
+  int64_t allocations_before = allocations.load(std::memory_order_relaxed);
+  for (auto _ : state) {
+    for (int i = 0; i < kBatch; ++i) {
+      tasks.emplace_back(make_task());
+    }
+    for (Functor& task : tasks) {
+      task();
+    }
+    tasks.clear();
+  }
+  int64_t tasks_count = state.iterations() * kBatch;
+  state.counters["allocs_per_task"] = benchmark::Counter(
+      static_cast<double>(allocations.load(std::memory_order_relaxed) -
+                          allocations_before) /
+      static_cast<double>(tasks_count));
+  state.SetItemsProcessed(tasks_count);
+}
+
+// `absl::bind_front(&TcpConnection::handleWrite, this)`
+template <typename Functor>
+void BM_BindMemberFunction(benchmark::State& state) {
+  Connection conn;
+  RunTasks<Functor>(state, [&conn] {
+    return absl::bind_front(&Connection::HandleWrite, &conn);
+  });
+}
+
+// The cross-thread `TcpConnection::send()`, holding the connection & payload.
+template <typename Functor>
+void BM_SharedPtrAndString(benchmark::State& state) {
+  auto conn = std::make_shared<Connection>();
+  const std::string payload(8, 'x');  // Short string, no allocation.
+  RunTasks<Functor>(state, [&conn, &payload] {
+    return [conn, message = payload] { conn->Send(message); };
+  });
+}
+
+// `absl::bind_front(callback, shared_from_this())` of the write complete
+// callback.
+template <typename Functor>
+void BM_BindCallbackAndSharedPtr(benchmark::State& state) {
+  auto conn = std::make_shared<Connection>();
+  std::function<void(const std::shared_ptr<Connection>&)> callback =
+      [](const std::shared_ptr<Connection>& c) { c->HandleWrite(); };
+  RunTasks<Functor>(
+      state, [&conn, &callback] { return absl::bind_front(callback, conn); });
+}
+
+using StdFunction = std::function<void()>;
+using SmallFunction = hcoona::SmallFunction<void()>;
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_BindMemberFunction, StdFunction);
+BENCHMARK_TEMPLATE(BM_BindMemberFunction, SmallFunction);
+BENCHMARK_TEMPLATE(BM_SharedPtrAndString, StdFunction);
+BENCHMARK_TEMPLATE(BM_SharedPtrAndString, SmallFunction);
+BENCHMARK_TEMPLATE(BM_BindCallbackAndSharedPtr, StdFunction);
+BENCHMARK_TEMPLATE(BM_BindCallbackAndSharedPtr, SmallFunction);
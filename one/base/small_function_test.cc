@@ -0,0 +1,98 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/base/small_function.h"
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "one/test/move_only_value.h"
+
+namespace hcoona {
+
+TEST(SmallFunction, Empty) {
+  SmallFunction<void()> f;
+  EXPECT_FALSE(f);
+  EXPECT_THROW(f(), std::bad_function_call);
+
+  SmallFunction<void()> g = std::function<void()>();
+  EXPECT_FALSE(g);
+
+  void (*null_function)() = nullptr;
+  SmallFunction<void()> h = null_function;
+  EXPECT_FALSE(h);
+}
+
+TEST(SmallFunction, InvokeInline) {
+  int sum = 0;
+  SmallFunction<int(int)> f = [&sum](int x) {
+    sum += x;
+    return sum;
+  };
+  EXPECT_TRUE(f);
+  EXPECT_EQ(f(1), 1);
+  EXPECT_EQ(f(2), 3);
+}
+
+TEST(SmallFunction, InvokeOnHeap) {
+  std::array<int, 32> values{};
+  values[31] = 42;
+  SmallFunction<int()> f = [values] { return values[31]; };
+  EXPECT_EQ(f(), 42);
+
+  SmallFunction<int()> g(std::move(f));
+  EXPECT_FALSE(f);  // NOLINT(bugprone-use-after-move)
+  EXPECT_EQ(g(), 42);
+}
+
+TEST(SmallFunction, MoveOnlyCallable) {
+  MoveOnlyValue<std::string> value("hello");
+  SmallFunction<std::string()> f = [value = std::move(value)] {
+    return value.value();
+  };
+  SmallFunction<std::string()> g;
+  g = std::move(f);
+  EXPECT_EQ(g(), "hello");
+}
+
+TEST(SmallFunction, DestroyCallable) {
+  auto counter = std::make_shared<int>(0);
+  {
+    SmallFunction<void()> f = [counter] { ++*counter; };
+    EXPECT_EQ(counter.use_count(), 2);
+    f();
+    SmallFunction<void()> g = std::move(f);
+    EXPECT_EQ(counter.use_count(), 2);
+    g = nullptr;
+    EXPECT_EQ(counter.use_count(), 1);
+  }
+  EXPECT_EQ(*counter, 1);
+}
+
+TEST(SmallFunction, ForwardArguments) {
+  SmallFunction<size_t(std::unique_ptr<std::string>, const std::string&)> f =
+      [](std::unique_ptr<std::string> a, const std::string& b) {
+        return a->size() + b.size();
+      };
+  EXPECT_EQ(f(std::make_unique<std::string>("abc"), "de"), 5);
+}
+
+}  // namespace hcoona
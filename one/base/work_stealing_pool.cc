@@ -0,0 +1,178 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/base/work_stealing_pool.h"
+
+#include <pthread.h>
+
+#include <cassert>
+
+namespace hcoona {
+
+namespace {
+
+// The pool & index of the worker running in this thread, if any.
+thread_local const WorkStealingPool* t_pool = nullptr;
+thread_local size_t t_index = 0;
+
+}  // namespace
+
+WorkStealingPool::WorkStealingPool(int num_threads, std::string name) {
+  assert(num_threads > 0);
+  workers_.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  // Start them after all the deques exist, a worker steals from any of them.
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i]->thread =
+        std::thread(&WorkStealingPool::WorkerLoop, this, i,
+                    name + std::to_string(i));
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(park_mutex_);
+    stopping_.store(true);
+  }
+  park_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+void WorkStealingPool::Post(Task task) {
+  if (t_pool == this) {
+    Worker& worker = *workers_[t_index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  } else {
+    std::lock_guard<std::mutex> lock(injection_mutex_);
+    injection_.push_back(std::move(task));
+  }
+  WakeUpOne();
+}
+
+bool WorkStealingPool::RunPendingTask() {
+  Task task;
+  // Not a worker, it takes from the shared ends only.
+  const bool taken =
+      t_pool == this
+          ? TryTake(t_index, /*wait_for_lock=*/false, &task)
+          : TryTakeInjected(&task) ||
+                TrySteal(0, workers_.size(), /*wait_for_lock=*/false, &task);
+  if (!taken) {
+    return false;
+  }
+  task();
+  return true;
+}
+
+void WorkStealingPool::WakeUpOne() {
+  // Pairs with the increment in `WorkerLoop()`, either the worker sees the
+  // task, or we see it's sleeping.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_sleeping_.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(park_mutex_);
+    park_cv_.notify_one();
+  }
+}
+
+bool WorkStealingPool::TryTake(size_t index, bool wait_for_lock, Task* task) {
+  {
+    Worker& self = *workers_[index];
+    std::lock_guard<std::mutex> lock(self.mutex);
+    if (!self.tasks.empty()) {
+      *task = std::move(self.tasks.back());
+      self.tasks.pop_back();
+      return true;
+    }
+  }
+  return TryTakeInjected(task) ||
+         TrySteal(index + 1, workers_.size() - 1, wait_for_lock, task);
+}
+
+bool WorkStealingPool::TryTakeInjected(Task* task) {
+  std::lock_guard<std::mutex> lock(injection_mutex_);
+  if (injection_.empty()) {
+    return false;
+  }
+  *task = std::move(injection_.front());
+  injection_.pop_front();
+  return true;
+}
+
+bool WorkStealingPool::TrySteal(size_t first, size_t count, bool wait_for_lock,
+                                Task* task) {
+  for (size_t i = 0; i < count; ++i) {
+    Worker& victim = *workers_[(first + i) % workers_.size()];
+    std::unique_lock<std::mutex> lock(victim.mutex, std::defer_lock);
+    if (wait_for_lock) {
+      lock.lock();
+    } else if (!lock.try_lock()) {
+      continue;
+    }
+    if (!victim.tasks.empty()) {
+      *task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      num_steals_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::WorkerLoop(size_t index, const std::string& name) {
+  ::pthread_setname_np(::pthread_self(), name.substr(0, 15).c_str());
+  t_pool = this;
+  t_index = index;
+
+  Task task;
+  for (;;) {
+    if (TryTake(index, /*wait_for_lock=*/false, &task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(park_mutex_);
+    num_sleeping_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // Read it before the re-check, the tasks posted before stopping must run.
+    const bool stopping = stopping_.load();
+    // Wait for the locks this time, a busy deque isn't an empty one.
+    const bool found = TryTake(index, /*wait_for_lock=*/true, &task);
+    if (!found && !stopping) {
+      park_cv_.wait(lock);
+    }
+    num_sleeping_.fetch_sub(1, std::memory_order_relaxed);
+    lock.unlock();
+
+    if (found) {
+      task();
+      task = nullptr;
+    } else if (stopping) {
+      // Nothing left anywhere.
+      break;
+    }
+  }
+
+  t_pool = nullptr;
+}
+
+}  // namespace hcoona
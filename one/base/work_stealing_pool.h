@@ -0,0 +1,135 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This header file defines `WorkStealingPool`, a fixed set of worker threads
+// for CPU-bound tasks which would otherwise stall an event loop, e.g.
+// compression, hashing or parsing big payloads.
+//
+// Each worker owns a deque of tasks. A task posted by a worker is pushed to
+// its own deque & popped LIFO while it's hot in the cache, an idle worker
+// steals the oldest one from the other end. Tasks posted from other threads,
+// e.g. an event loop, go to a shared FIFO queue.
+//
+// `Submit()` returns a `Future`, hand the result back to the loop with
+//
+//   pool->Submit([data = std::move(data)] { return Compress(data); })
+//       .Then([loop](auto task) { loop->RunInLoop(std::move(task)); },
+//             [conn](std::string compressed) { conn->send(compressed); });
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "one/base/future.h"
+#include "one/base/small_function.h"
+
+namespace hcoona {
+
+class WorkStealingPool {
+ public:
+  using Task = SmallFunction<void()>;
+
+  // Starts `num_threads` workers, named `name` followed by their index.
+  explicit WorkStealingPool(int num_threads, std::string name = "worker");
+
+  // Runs the tasks left, then joins the workers.
+  ~WorkStealingPool();
+
+  // Disallow copy.
+  WorkStealingPool(const WorkStealingPool&) noexcept = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) noexcept = delete;
+
+  // Disallow move.
+  WorkStealingPool(WorkStealingPool&&) noexcept = delete;
+  WorkStealingPool& operator=(WorkStealingPool&&) noexcept = delete;
+
+  [[nodiscard]] int num_threads() const {
+    return static_cast<int>(workers_.size());
+  }
+
+  // Thread safe. The task must not throw, use `Submit()` for one which may.
+  void Post(Task task);
+
+  // Thread safe. Runs `f()` in a worker, the future is set with its result,
+  // or the exception it throws.
+  template <typename F>
+  auto Submit(F&& f) {
+    using R = std::invoke_result_t<std::decay_t<F>&>;
+    Promise<R> promise;
+    Future<R> future = promise.GetFuture();
+    Post([promise = std::move(promise), f = std::forward<F>(f)]() mutable {
+      details::Fulfill<void>(&promise, f, details::FutureResult<void>());
+    });
+    return future;
+  }
+
+  // Runs a pending task in this thread if there's any, so a task waiting for
+  // another one helps out instead of blocking its worker. A thread other than
+  // the workers steals like one, it never takes from a worker's own end.
+  bool RunPendingTask();
+
+  // The number of tasks taken from another worker's deque.
+  [[nodiscard]] int64_t num_steals() const {
+    return num_steals_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct alignas(64) Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  void WorkerLoop(size_t index, const std::string& name);
+
+  // Own deque first, then the shared queue, then steal from the others. Skips
+  // a locked deque unless `wait_for_lock`.
+  bool TryTake(size_t index, bool wait_for_lock, Task* task);
+  bool TryTakeInjected(Task* task);
+  // From the FIFO end of `count` deques starting at `first`, the owners take
+  // from the other end.
+  bool TrySteal(size_t first, size_t count, bool wait_for_lock, Task* task);
+
+  void WakeUpOne();
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  std::mutex injection_mutex_;
+  std::deque<Task> injection_;
+
+  // Guards parking, a worker re-checks all queues after it counts itself in
+  // `num_sleeping_`, so a task posted meanwhile is never missed.
+  std::mutex park_mutex_;
+  std::condition_variable park_cv_;
+  std::atomic<int> num_sleeping_{0};
+  std::atomic<bool> stopping_{false};
+
+  std::atomic<int64_t> num_steals_{0};
+};
+
+}  // namespace hcoona
@@ -0,0 +1,223 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/base/work_stealing_pool.h"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace hcoona {
+
+namespace {
+
+// A minimal loop, runs the tasks posted to it in the thread calling `Run()`.
+class FakeLoop {
+ public:
+  void Post(SmallFunction<void()> task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+
+  void RunUntil(const std::atomic<bool>& done) {
+    while (!done.load()) {
+      std::vector<SmallFunction<void()>> tasks;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks.swap(tasks_);
+      }
+      for (auto& task : tasks) {
+        task();
+      }
+      std::this_thread::yield();
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<SmallFunction<void()>> tasks_;
+};
+
+int64_t Fibonacci(WorkStealingPool* pool, int n) {
+  if (n < 2) {
+    return n;
+  }
+  Future<int64_t> left =
+      pool->Submit([pool, n] { return Fibonacci(pool, n - 1); });
+  int64_t right = Fibonacci(pool, n - 2);
+  // Help out instead of blocking a worker, the left half may sit in our deque.
+  while (!left.ready()) {
+    if (!pool->RunPendingTask()) {
+      std::this_thread::yield();
+    }
+  }
+  return left.Get() + right;
+}
+
+}  // namespace
+
+TEST(Future, GetAndThen) {
+  Promise<int> promise;
+  Future<int> future = promise.GetFuture();
+  EXPECT_FALSE(future.ready());
+  promise.SetValue(20);
+  EXPECT_TRUE(future.ready());
+
+  Future<std::string> chained =
+      future.Then([](int v) { return std::to_string(v + 1); });
+  EXPECT_FALSE(future.valid());
+  EXPECT_EQ("21", chained.Get());
+}
+
+TEST(Future, ThenBeforeSet) {
+  Promise<void> promise;
+  int calls = 0;
+  Future<int> chained = promise.GetFuture().Then([&calls] { return ++calls; });
+  EXPECT_EQ(0, calls);
+  promise.SetValue();
+  EXPECT_EQ(1, chained.Get());
+}
+
+TEST(Future, MoveOnlyValue) {
+  Promise<std::unique_ptr<int>> promise;
+  Future<int> chained = promise.GetFuture().Then(
+      [](std::unique_ptr<int> v) { return *v; });
+  promise.SetValue(std::make_unique<int>(7));
+  EXPECT_EQ(7, chained.Get());
+}
+
+TEST(Future, BrokenPromise) {
+  Future<int> future;
+  {
+    Promise<int> promise;
+    future = promise.GetFuture();
+  }
+  EXPECT_TRUE(future.ready());
+  try {
+    future.Get();
+    ADD_FAILURE() << "no exception";
+  } catch (const std::future_error& e) {
+    EXPECT_EQ(std::future_errc::broken_promise, e.code());
+  }
+}
+
+TEST(Future, ExceptionSkipsThen) {
+  Promise<int> promise;
+  int calls = 0;
+  Future<int> chained = promise.GetFuture()
+                            .Then([](int v) -> int {
+                              throw std::runtime_error(std::to_string(v));
+                            })
+                            .Then([&calls](int v) { return v + ++calls; });
+  promise.SetValue(3);
+  EXPECT_THROW(chained.Get(), std::runtime_error);
+  EXPECT_EQ(0, calls);
+}
+
+TEST(WorkStealingPool, Submit) {
+  WorkStealingPool pool(4, "test");
+  EXPECT_EQ(4, pool.num_threads());
+
+  std::vector<Future<int>> futures;
+  for (int i = 0; i < 100; ++i) {
+    futures.push_back(pool.Submit([i] { return i * i; }));
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(i * i, futures[i].Get());
+  }
+}
+
+TEST(WorkStealingPool, SubmitThrows) {
+  WorkStealingPool pool(2);
+  Future<int> future =
+      pool.Submit([]() -> int { throw std::runtime_error("task"); });
+  EXPECT_THROW(future.Get(), std::runtime_error);
+  // The worker is still there.
+  EXPECT_EQ(1, pool.Submit([] { return 1; }).Get());
+}
+
+TEST(WorkStealingPool, DrainsOnDestruction) {
+  std::atomic<int> count{0};
+  {
+    WorkStealingPool pool(2);
+    for (int i = 0; i < 1000; ++i) {
+      pool.Post([&count] { count.fetch_add(1); });
+    }
+  }
+  EXPECT_EQ(1000, count.load());
+}
+
+TEST(WorkStealingPool, Nested) {
+  WorkStealingPool pool(4);
+  EXPECT_EQ(6765, pool.Submit([&pool] { return Fibonacci(&pool, 20); }).Get());
+}
+
+TEST(WorkStealingPool, OutsiderStealsOldest) {
+  WorkStealingPool pool(1);
+  std::promise<void> posted;
+  std::promise<void> release;
+  std::vector<int> order;
+  pool.Post([&] {
+    pool.Post([&order] { order.push_back(1); });
+    pool.Post([&order] { order.push_back(2); });
+    posted.set_value();
+    // Keeps the only worker away from its deque.
+    release.get_future().wait();
+  });
+  posted.get_future().wait();
+  // Taken from the FIFO end, the worker owns the other one.
+  EXPECT_TRUE(pool.RunPendingTask());
+  EXPECT_TRUE(pool.RunPendingTask());
+  EXPECT_FALSE(pool.RunPendingTask());
+  release.set_value();
+  EXPECT_EQ((std::vector<int>{1, 2}), order);
+  EXPECT_EQ(2, pool.num_steals());
+}
+
+TEST(WorkStealingPool, ThenInLoop) {
+  WorkStealingPool pool(2);
+  FakeLoop loop;
+  std::atomic<bool> done{false};
+  const std::thread::id loop_thread = std::this_thread::get_id();
+
+  std::thread::id worker_thread;
+  std::thread::id continuation_thread;
+  pool.Submit([&worker_thread] {
+        worker_thread = std::this_thread::get_id();
+        return 41;
+      })
+      .Then([&loop](auto task) { loop.Post(std::move(task)); },
+            [&](int v) {
+              continuation_thread = std::this_thread::get_id();
+              EXPECT_EQ(42, v + 1);
+              done.store(true);
+            });
+  loop.RunUntil(done);
+
+  EXPECT_NE(loop_thread, worker_thread);
+  EXPECT_EQ(loop_thread, continuation_thread);
+}
+
+}  // namespace hcoona
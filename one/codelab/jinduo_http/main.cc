@@ -64,7 +64,6 @@
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "one/jinduo/net/event_loop.h"
-#include "one/jinduo/net/event_loop_thread_pool.h"
 #include "one/jinduo/net/http/http_request.h"
 #include "one/jinduo/net/http/http_response.h"
 #include "one/jinduo/net/http/http_server.h"
@@ -151,25 +150,15 @@ int main(int argc, char* argv[]) {
   signal_handler_manager.SetSignalCallback(SIGINT, signal_handler);
   signal_handler_manager.SetSignalCallback(SIGTERM, signal_handler);
 
-  jinduo::net::EventLoopThreadPool threadPool(&loop, "shorturl");
+  // Each io loop listens on the port & owns the connections it accepts.
+  jinduo::net::HttpServer server(&loop, jinduo::net::InetAddress(kBindingPort),
+                                 "shorturl",
+                                 jinduo::net::TcpServer::kReusePortPerLoop);
+  server.setHttpCallback(onRequest);
   if (numThreads > 0) {
-    threadPool.set_thread_num(numThreads);
-  } else {
-    numThreads = 0;
-  }
-  threadPool.Start();
-
-  std::vector<jinduo::net::HttpServer*> servers;
-  for (int i = 0; i < numThreads; ++i) {
-    auto* loop = threadPool.GetNextLoop();
-    auto server = std::make_shared<jinduo::net::HttpServer>(
-        loop, jinduo::net::InetAddress(kBindingPort), "shorturl",
-        jinduo::net::TcpServer::kReusePort);
-    servers.emplace_back(server.get());
-    server->setHttpCallback(onRequest);
-    server->getLoop()->RunInLoop([server = server.get()] { server->start(); });
-    loop->set_context(std::move(server));
+    server.set_thread_num(numThreads);
   }
+  server.start();
   loop.Loop();
 }
 
@@ -29,8 +29,6 @@
 #include "one/codelab/minikafka/core/kafka_service.h"
 #include "one/codelab/minikafka/transport/kafka_tcp_server.h"
 #include "one/jinduo/net/event_loop.h"
-#include "one/jinduo/net/event_loop_thread.h"
-#include "one/jinduo/net/event_loop_thread_pool.h"
 #include "one/jinduo/net/signal_handler_manager.h"
 
 namespace {
@@ -40,22 +38,16 @@ bool ValidateTcpPort(const char* /*flag_name*/, uint32_t value) {
          absl::implicit_cast<uint32_t>(std::numeric_limits<uint16_t>::max());
 }
 
-void HandleSignal(
-    jinduo::net::EventLoop* loop,
-    hcoona::minikafka::KafkaService* kafka_service,
-    std::vector<hcoona::minikafka::KafkaTcpServer*>* kafka_tcp_servers,
-    int signum) {
+void HandleSignal(hcoona::minikafka::KafkaService* kafka_service,
+                  hcoona::minikafka::KafkaTcpServer* kafka_tcp_server,
+                  int signum) {
   CHECK(signum == SIGTERM || signum == SIGINT);
 
   LOG(WARNING) << "SIGTERM|SIGINT received, exiting...";
 
-  // The events are drained during event loop quiting.
-  loop->QueueInLoop(absl::bind_front(&jinduo::net::EventLoop::Quit, loop));
-
-  // Child loops exited during kafka tcp server stopping.
-  for (auto&& s : *kafka_tcp_servers) {
-    s->Stop();
-  }
+  // The events are drained during event loop quiting, child loops exit along
+  // with the kafka tcp server.
+  kafka_tcp_server->Stop();
 
   // TODO(zhangshuai.ustc): graceful shutdown the service.
   (void)kafka_service;
@@ -78,33 +70,22 @@ int main(int argc, char* argv[]) {
   // service.
 
   jinduo::net::EventLoop loop;
-  jinduo::net::EventLoopThreadPool event_loop_thread_pool(&loop, "minikafka");
-  event_loop_thread_pool.set_thread_num(
-      static_cast<int>(std::thread::hardware_concurrency()));
 
   hcoona::minikafka::KafkaService kafka_service;
-  std::vector<hcoona::minikafka::KafkaTcpServer*> kafka_tcp_servers;
+  // Each child loop listens on the port & owns the connections it accepts.
+  hcoona::minikafka::KafkaTcpServer kafka_tcp_server(
+      &kafka_service, &loop, jinduo::net::InetAddress(FLAGS_port),
+      static_cast<int>(std::thread::hardware_concurrency()));
 
   jinduo::net::SignalHandlerManager signal_handler_manager(&loop);
   signal_handler_manager.SetSignalCallback(
-      SIGINT, absl::bind_front(&HandleSignal, &loop, &kafka_service,
-                               &kafka_tcp_servers));
+      SIGINT,
+      absl::bind_front(&HandleSignal, &kafka_service, &kafka_tcp_server));
   signal_handler_manager.SetSignalCallback(
-      SIGTERM, absl::bind_front(&HandleSignal, &loop, &kafka_service,
-                                &kafka_tcp_servers));
-
-  event_loop_thread_pool.Start();
-
-  kafka_tcp_servers.reserve(std::thread::hardware_concurrency());
-  for (jinduo::net::EventLoop* child_loop :
-       event_loop_thread_pool.all_loops()) {
-    auto kafka_tcp_server = std::make_shared<hcoona::minikafka::KafkaTcpServer>(
-        &kafka_service, child_loop, jinduo::net::InetAddress(FLAGS_port));
-    kafka_tcp_servers.emplace_back(kafka_tcp_server.get());
-    child_loop->RunInLoop([s = kafka_tcp_server.get()] { s->Start(); });
-    // It's safe to store `std::shared_ptr` in `std::any`.
-    child_loop->set_context(std::move(kafka_tcp_server));
-  }
+      SIGTERM,
+      absl::bind_front(&HandleSignal, &kafka_service, &kafka_tcp_server));
+
+  kafka_tcp_server.Start();
 
   LOG(INFO) << "Minikafka service is running at port " << FLAGS_port;
 
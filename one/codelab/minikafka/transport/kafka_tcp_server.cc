@@ -25,11 +25,13 @@ namespace minikafka {
 
 KafkaTcpServer::KafkaTcpServer(KafkaService* kafka_service,
                                jinduo::net::EventLoop* loop,
-                               const jinduo::net::InetAddress& listen_address)
+                               const jinduo::net::InetAddress& listen_address,
+                               int num_threads)
     : kafka_service_(kafka_service),
       loop_(loop),
       tcp_server_(loop, listen_address, "minikafka-server",
-                  jinduo::net::TcpServer::kReusePort) {
+                  jinduo::net::TcpServer::kReusePortPerLoop) {
+  tcp_server_.set_thread_num(num_threads);
   tcp_server_.setConnectionCallback(
       absl::bind_front(&KafkaTcpServer::OnConnect, this));
 }
@@ -43,14 +45,14 @@ void KafkaTcpServer::OnConnect(
   absl::MutexLock lock(&mutex_);
   if (connection->connected()) {
     auto result = sessions_.try_emplace(
-        connection->name(),
+        connection->id(),
         std::make_shared<KafkaTcpSession>(kafka_service_, connection));
     CHECK(result.second);
 
     VLOG(1) << "Connection established. remote="
             << connection->peerAddress().toIpPort();
   } else {
-    CHECK_NE(sessions_.erase(connection->name()), static_cast<size_t>(0));
+    CHECK_NE(sessions_.erase(connection->id()), static_cast<size_t>(0));
 
     VLOG(1) << "Connection destoried. remote="
             << connection->peerAddress().toIpPort();
@@ -34,8 +34,11 @@ namespace minikafka {
 
 class KafkaTcpServer {
  public:
+  // Accepts & serves the connections in `num_threads` io loops, each one
+  // listening on the address with SO_REUSEPORT, or in `loop` if it's 0.
   KafkaTcpServer(KafkaService* kafka_service, jinduo::net::EventLoop* loop,
-                 const jinduo::net::InetAddress& listen_address);
+                 const jinduo::net::InetAddress& listen_address,
+                 int num_threads);
   virtual ~KafkaTcpServer() = default;
 
   // Disallow copy.
@@ -60,8 +63,9 @@ class KafkaTcpServer {
   jinduo::net::TcpServer tcp_server_;
 
   mutable absl::Mutex mutex_;
-  absl::flat_hash_map<std::string, std::shared_ptr<KafkaTcpSession>> sessions_
-      ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<jinduo::net::ConnectionId,
+                      std::shared_ptr<KafkaTcpSession>>
+      sessions_ ABSL_GUARDED_BY(mutex_);
 };
 
 }  // namespace minikafka
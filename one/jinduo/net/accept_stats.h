@@ -0,0 +1,44 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is a public header file, it must only include public header files.
+
+#pragma once
+
+#include <cstdint>
+
+namespace jinduo {
+namespace net {
+
+// Counters of the listening sockets of a `TcpServer`, since it starts.
+struct AcceptStats {
+  // Connections accepted, sample it periodically for the accept rate.
+  uint64_t accepted{0};
+  // accept(2) failures, e.g. running out of fds.
+  uint64_t errors{0};
+  // Read events stopped by the accept budget with connections left pending.
+  uint64_t budget_exhausted{0};
+  // Times the accept queue was seen full, the kernel drops the handshakes
+  // meanwhile, counted as ListenOverflows in /proc/net/netstat. The queue is
+  // only sampled while connections come in faster than the accept budget.
+  uint64_t backlog_full{0};
+  // The longest accept queue seen.
+  uint32_t max_backlog{0};
+};
+
+}  // namespace net
+}  // namespace jinduo
@@ -39,28 +39,31 @@ ssize_t Buffer::readFd(int fd, int* savedErrno) {
   // saved an ioctl()/FIONREAD call to tell how much to read
   static constexpr size_t kBufferSize = 65536;
   char extrabuf[kBufferSize];
+  // when there is enough space in this buffer, don't read into extrabuf.
+  // when extrabuf is used, we read 128k-1 bytes at most.
+  const size_t extrasize =
+      (writableBytes() < sizeof extrabuf) ? sizeof extrabuf : 0;
+  return readFd(fd, extrabuf, extrasize, savedErrno);
+}
+
+ssize_t Buffer::readFd(int fd, char* extrabuf, size_t extrasize,
+                       int* savedErrno) {
   struct iovec vec[2];
   const size_t writable = writableBytes();
   vec[0].iov_base = begin() + writerIndex_;
   vec[0].iov_len = writable;
   vec[1].iov_base = extrabuf;
-  vec[1].iov_len = sizeof extrabuf;
-  // when there is enough space in this buffer, don't read into extrabuf.
-  // when extrabuf is used, we read 128k-1 bytes at most.
-  const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
+  vec[1].iov_len = extrasize;
+  const int iovcnt = extrasize > 0 ? 2 : 1;
   const ssize_t n = sockets::readv(fd, vec, iovcnt);
   if (n < 0) {
     *savedErrno = errno;
   } else if (absl::implicit_cast<size_t>(n) <= writable) {
     writerIndex_ += n;
   } else {
-    writerIndex_ = buffer_.size();
+    writerIndex_ += writable;
     append(extrabuf, n - writable);
   }
-  // if (n == writable + sizeof extrabuf)
-  // {
-  //   goto line_30;
-  // }
   return n;
 }
 
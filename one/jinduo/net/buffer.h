@@ -77,7 +77,8 @@ class Buffer {
   }
 
   [[nodiscard]] size_t writableBytes() const {
-    return buffer_.size() - writerIndex_;
+    // No storage at all after releaseStorage().
+    return buffer_.empty() ? 0 : buffer_.size() - writerIndex_;
   }
 
   [[nodiscard]] size_t prependableBytes() const { return readerIndex_; }
@@ -306,6 +307,9 @@ class Buffer {
 
   void prepend(const void* /*restrict*/ data, size_t len) {
     assert(len <= prependableBytes());
+    if (buffer_.empty()) {
+      buffer_.resize(kCheapPrepend);
+    }
     readerIndex_ -= len;
     const char* d = static_cast<const char*>(data);
     std::copy(d, d + len, begin() + readerIndex_);
@@ -321,16 +325,48 @@ class Buffer {
 
   [[nodiscard]] size_t internalCapacity() const { return buffer_.capacity(); }
 
+  /// Takes @c storage as the underlying memory, the buffer must be empty.
+  ///
+  /// It's for buffers drawing memory from a pool, see releaseStorage().
+  void adoptStorage(std::vector<char>&& storage) {
+    assert(readableBytes() == 0);
+    assert(storage.size() > kCheapPrepend);
+    buffer_ = std::move(storage);
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend;
+  }
+
+  /// Gives away the underlying memory, the buffer must be empty.
+  ///
+  /// The buffer holds no memory after that, until it's written again.
+  std::vector<char> releaseStorage() {
+    assert(readableBytes() == 0);
+    std::vector<char> storage;
+    storage.swap(buffer_);
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend;
+    return storage;
+  }
+
   /// Read data directly into buffer.
   ///
   /// It may implement with readv(2)
   /// @return result of read(2), @c errno is saved
   ssize_t readFd(int fd, int* savedErrno);
 
+  /// Read data directly into buffer, with a single readv(2).
+  ///
+  /// It reads at most writableBytes() + @c extrasize bytes, the part that
+  /// doesn't fit into the buffer lands in @c extrabuf first, and is appended
+  /// then. So the caller controls how much to read at a time, and could share
+  /// a large @c extrabuf among many buffers.
+  /// @return result of read(2), @c errno is saved
+  ssize_t readFd(int fd, char* extrabuf, size_t extrasize, int* savedErrno);
+
  private:
-  char* begin() { return &*buffer_.begin(); }
+  char* begin() { return buffer_.data(); }
 
-  [[nodiscard]] const char* begin() const { return &*buffer_.begin(); }
+  [[nodiscard]] const char* begin() const { return buffer_.data(); }
 
   void makeSpace(size_t len) {
     if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
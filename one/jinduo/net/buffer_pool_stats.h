@@ -0,0 +1,42 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is a public header file, it must only include public header files.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace jinduo {
+namespace net {
+
+// Statistics of one size class of the buffer memory pool of an `EventLoop`.
+struct BufferPoolStats {
+  size_t block_size{0};
+  // Blocks kept in the free list.
+  size_t free_blocks{0};
+  // Blocks handed out & not given back yet.
+  int64_t outstanding_blocks{0};
+  // Allocations served by the free list.
+  uint64_t hits{0};
+  // Allocations fell back to the system allocator.
+  uint64_t misses{0};
+};
+
+}  // namespace net
+}  // namespace jinduo
@@ -22,7 +22,13 @@
 
 #include "one/jinduo/net/buffer.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -119,6 +125,30 @@ TEST(Buffer, Shrink) {
   EXPECT_EQ(buf.prependableBytes(), Buffer::kCheapPrepend);
 }
 
+TEST(Buffer, ReleaseStorage) {
+  Buffer buf;
+  buf.append(std::string(100, 'x'));
+  buf.retrieveAll();
+
+  std::vector<char> storage = buf.releaseStorage();
+  EXPECT_EQ(storage.size(), Buffer::kCheapPrepend + Buffer::kInitialSize);
+  EXPECT_EQ(buf.internalCapacity(), 0);
+  EXPECT_EQ(buf.readableBytes(), 0);
+  EXPECT_EQ(buf.writableBytes(), 0);
+
+  // Grows on demand after releasing.
+  buf.append(std::string(10, 'y'));
+  EXPECT_EQ(buf.retrieveAllAsString(), std::string(10, 'y'));
+  buf.releaseStorage();
+  buf.prependInt32(42);
+  EXPECT_EQ(buf.readInt32(), 42);
+
+  buf.releaseStorage();
+  buf.adoptStorage(std::move(storage));
+  EXPECT_EQ(buf.writableBytes(), Buffer::kInitialSize);
+  EXPECT_EQ(buf.prependableBytes(), Buffer::kCheapPrepend);
+}
+
 TEST(Buffer, Prepend) {
   Buffer buf;
   buf.append(std::string(200, 'y'));
@@ -184,3 +214,30 @@ TEST(Buffer, Move) {
   // printf("Buffer at %p, inner %p\n", &buf, inner);
   output(std::move(buf), inner);
 }
+
+TEST(Buffer, ReadFdWithExtraBuffer) {
+  int fds[2];
+  ASSERT_EQ(::pipe2(fds, O_NONBLOCK | O_CLOEXEC), 0);
+  std::string str(3000, 'r');
+  ASSERT_EQ(::write(fds[1], str.data(), str.size()),
+            static_cast<ssize_t>(str.size()));
+
+  Buffer buf(1000);
+  char extrabuf[1500];
+  int savedErrno = 0;
+  // Read no more than the writable bytes plus the size of extrabuf.
+  EXPECT_EQ(buf.readFd(fds[0], extrabuf, sizeof extrabuf, &savedErrno), 2500);
+  EXPECT_EQ(buf.readableBytes(), 2500);
+
+  // Read into the writable bytes only.
+  buf.retrieveAll();
+  const size_t writable = buf.writableBytes();
+  EXPECT_EQ(buf.readFd(fds[0], extrabuf, 0, &savedErrno), 500);
+  EXPECT_EQ(buf.writableBytes(), writable - 500);
+
+  EXPECT_EQ(buf.readFd(fds[0], extrabuf, sizeof extrabuf, &savedErrno), -1);
+  EXPECT_EQ(savedErrno, EAGAIN);
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
@@ -27,11 +27,13 @@
 
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 
 #include "absl/time/time.h"
 #include "one/base/down_cast.h"
+#include "one/base/small_function.h"
 
 namespace jinduo {
 namespace net {
@@ -40,7 +42,9 @@ namespace net {
 
 class Buffer;
 class TcpConnection;
-using TimerCallback = std::function<void()>;
+// Unique in a TcpServer, never reused.
+using ConnectionId = uint64_t;
+using TimerCallback = hcoona::SmallFunction<void()>;
 using ConnectionCallback =
     std::function<void(const std::shared_ptr<TcpConnection>&)>;
 using CloseCallback =
@@ -50,6 +54,15 @@ using WriteCompleteCallback =
 using HighWaterMarkCallback =
     std::function<void(const std::shared_ptr<TcpConnection>&, size_t)>;
 
+// Which limit of TcpServer a connection exceeds.
+enum class ConnectionTimeout {
+  kReadIdle,   // nothing received
+  kWriteIdle,  // nothing sent
+  kLifetime,   // since established
+};
+using ConnectionTimeoutCallback = std::function<void(
+    const std::shared_ptr<TcpConnection>&, ConnectionTimeout)>;
+
 // the data has been read to (buf, len)
 using MessageCallback = std::function<void(
     const std::shared_ptr<TcpConnection>&, Buffer*, absl::Time)>;
@@ -57,6 +70,9 @@ using MessageCallback = std::function<void(
 void defaultConnectionCallback(const std::shared_ptr<TcpConnection>& conn);
 void defaultMessageCallback(const std::shared_ptr<TcpConnection>& conn,
                             Buffer* buffer, absl::Time receiveTime);
+// Closes the connection.
+void defaultConnectionTimeoutCallback(
+    const std::shared_ptr<TcpConnection>& conn, ConnectionTimeout timeout);
 
 }  // namespace net
 }  // namespace jinduo
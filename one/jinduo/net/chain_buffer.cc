@@ -0,0 +1,251 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/chain_buffer.h"
+
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include "absl/base/casts.h"
+#include "one/jinduo/net/internal/buffer_pool.h"
+#include "one/jinduo/net/internal/sockets_ops.h"
+
+namespace jinduo {
+namespace net {
+
+const size_t ChainBuffer::kSegmentSize;
+const int ChainBuffer::kMaxIovecs;
+const size_t ChainBuffer::kMaxCopySliceSize;
+
+ChainBuffer::ChainBuffer(BufferPool* pool) : pool_(pool) {}
+
+ChainBuffer::~ChainBuffer() { retrieveAll(); }
+
+void ChainBuffer::append(const char* /*restrict*/ data, size_t len) {
+  while (len > 0) {
+    if (segments_.empty() || segments_.back().block.empty() ||
+        segments_.back().writerIndex == kSegmentSize) {
+      appendSegment();
+    }
+    Segment& tail = segments_.back();
+    size_t n = std::min(len, kSegmentSize - tail.writerIndex);
+    ::memcpy(tail.block.data() + tail.writerIndex, data, n);
+    tail.writerIndex += n;
+    readableBytes_ += n;
+    data += n;
+    len -= n;
+  }
+}
+
+void ChainBuffer::append(Slice&& slice) {
+  if (slice.size() <= kMaxCopySliceSize) {
+    append(slice.data(), slice.size());
+    return;
+  }
+  Segment segment;
+  segment.writerIndex = slice.size();
+  segment.slice = std::move(slice);
+  readableBytes_ += segment.writerIndex;
+  segments_.push_back(std::move(segment));
+}
+
+void ChainBuffer::appendFile(int fd, off_t offset, size_t length) {
+  if (length == 0) {
+    ::close(fd);
+    return;
+  }
+  struct stat st {};
+  Segment segment;
+  segment.file = fd;
+  segment.fileOffset = offset;
+  segment.isPipe = ::fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+  segment.writerIndex = length;
+  readableBytes_ += length;
+  segments_.push_back(std::move(segment));
+}
+
+void ChainBuffer::retrieve(size_t len) {
+  assert(len <= readableBytes_);
+  while (len > 0) {
+    Segment& head = segments_.front();
+    size_t readable = head.writerIndex - head.readerIndex;
+    if (len < readable) {
+      head.readerIndex += len;
+      readableBytes_ -= len;
+      break;
+    }
+    len -= readable;
+    readableBytes_ -= readable;
+    releaseSegment(&head);
+    segments_.pop_front();
+  }
+}
+
+void ChainBuffer::retrieveAll() {
+  for (Segment& segment : segments_) {
+    releaseSegment(&segment);
+  }
+  segments_.clear();
+  readableBytes_ = 0;
+}
+
+std::string ChainBuffer::retrieveAllAsString() {
+  std::string result;
+  result.reserve(readableBytes_);
+  for (const Segment& segment : segments_) {
+    if (segment.file < 0) {
+      result.append(segment.data() + segment.readerIndex,
+                    segment.writerIndex - segment.readerIndex);
+      continue;
+    }
+    // Only for tests & debugging, no need to be efficient.
+    size_t oldSize = result.size();
+    size_t len = segment.writerIndex - segment.readerIndex;
+    result.resize(oldSize + len);
+    off_t offset = segment.fileOffset + segment.readerIndex;
+    ssize_t n =
+        segment.isPipe ? ::read(segment.file, result.data() + oldSize, len)
+                       : ::pread(segment.file, result.data() + oldSize, len,
+                                 offset);
+    result.resize(oldSize + std::max<ssize_t>(n, 0));
+  }
+  retrieveAll();
+  return result;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int* savedErrno) {
+  if (!segments_.empty() && segments_.front().file >= 0) {
+    return writeFile(fd, &segments_.front(), savedErrno);
+  }
+  if (!segments_.empty() && isZeroCopyable(segments_.front())) {
+    ssize_t n = writeZeroCopy(fd, segments_.front(), savedErrno);
+    // Copied below if the kernel is short of memory to pin the pages.
+    if (n >= 0 || *savedErrno != ENOBUFS) {
+      return n;
+    }
+  }
+
+  struct iovec vec[kMaxIovecs];
+  int iovcnt = 0;
+  for (auto it = segments_.begin();
+       it != segments_.end() && it->file < 0 && iovcnt < kMaxIovecs &&
+       (iovcnt == 0 || !isZeroCopyable(*it));
+       ++it) {
+    vec[iovcnt].iov_base = const_cast<char*>(it->data()) + it->readerIndex;
+    vec[iovcnt].iov_len = it->writerIndex - it->readerIndex;
+    ++iovcnt;
+  }
+  const ssize_t n = sockets::writev(fd, vec, iovcnt);
+  if (n < 0) {
+    *savedErrno = errno;
+  } else {
+    retrieve(absl::implicit_cast<size_t>(n));
+  }
+  return n;
+}
+
+int ChainBuffer::emptyPipe() const {
+  if (segments_.empty() || !segments_.front().isPipe) {
+    return -1;
+  }
+  const int fd = segments_.front().file;
+  int readable = 0;
+  // At EOF too, which splice(2) reports once the pipe is polled readable.
+  return ::ioctl(fd, FIONREAD, &readable) == 0 && readable == 0 ? fd : -1;
+}
+
+ssize_t ChainBuffer::writeFile(int fd, Segment* segment, int* savedErrno) {
+  size_t len = segment->writerIndex - segment->readerIndex;
+  ssize_t n = 0;
+  if (segment->isPipe) {
+    n = sockets::splice(fd, segment->file, len);
+  } else {
+    off_t offset = segment->fileOffset + segment->readerIndex;
+    n = sockets::sendfile(fd, segment->file, &offset, len);
+  }
+  if (n < 0) {
+    *savedErrno = errno;
+  } else if (n == 0) {
+    // The file is shorter than the region, there's nothing more to send, drop
+    // the rest to avoid spinning on it.
+    retrieve(len);
+    *savedErrno = ENODATA;
+    return -1;
+  } else {
+    retrieve(absl::implicit_cast<size_t>(n));
+  }
+  return n;
+}
+
+ssize_t ChainBuffer::writeZeroCopy(int fd, const Segment& segment,
+                                   int* savedErrno) {
+  struct iovec vec {};
+  vec.iov_base = const_cast<char*>(segment.data()) + segment.readerIndex;
+  vec.iov_len = segment.writerIndex - segment.readerIndex;
+  const ssize_t n = sockets::sendZeroCopy(fd, &vec, 1);
+  if (n < 0) {
+    *savedErrno = errno;
+    return n;
+  }
+  // Holds the payload, the segment may be released by the retrieving.
+  zeroCopyPending_.push_back({nextZeroCopyId_++, segment.slice});
+  retrieve(absl::implicit_cast<size_t>(n));
+  return n;
+}
+
+void ChainBuffer::releaseZeroCopied(uint32_t lo, uint32_t hi) {
+  // Bounded by the sends pending rather than the range reported. The ids
+  // wrap around, an id is in the range by its distance from @c lo.
+  for (ZeroCopySend& send : zeroCopyPending_) {
+    if (send.id - lo <= hi - lo) {
+      send.completed = true;
+    }
+  }
+  while (!zeroCopyPending_.empty() && zeroCopyPending_.front().completed) {
+    zeroCopyPending_.pop_front();
+  }
+}
+
+void ChainBuffer::appendSegment() {
+  Segment segment;
+  segment.block = pool_ != nullptr ? pool_->Allocate(kSegmentSize)
+                                  : std::vector<char>(kSegmentSize);
+  segments_.push_back(std::move(segment));
+}
+
+void ChainBuffer::releaseSegment(Segment* segment) {
+  if (segment->file >= 0) {
+    ::close(segment->file);
+    segment->file = -1;
+    return;
+  }
+  // The slice is released along with the segment.
+  if (!segment->block.empty() && pool_ != nullptr) {
+    pool_->Deallocate(std::move(segment->block), kSegmentSize);
+  }
+}
+
+}  // namespace net
+}  // namespace jinduo
@@ -0,0 +1,184 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is a public header file, it must only include public header files.
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "one/jinduo/net/slice.h"
+
+namespace jinduo {
+namespace net {
+
+class BufferPool;
+
+/// An append-only output buffer made of fixed-size segments.
+///
+/// Unlike @c Buffer, appending never moves the bytes already queued, so a slow
+/// consumer costs one segment allocation per @c kSegmentSize bytes instead of
+/// reallocating & copying the whole backlog. Segments are drawn from the
+/// owner loop's pool, and flushed with a single writev(2).
+///
+/// A @c Slice is linked into the chain as a segment of its own instead of
+/// being copied, unless it's smaller than @c kMaxCopySliceSize. So does a file
+/// region, which is flushed with sendfile(2), or splice(2) for a pipe, in the
+/// order it's appended.
+///
+/// @code
+/// +-----------+      +-----------+      +-----------+
+/// | segment 0 | ---> | segment 1 | ---> | segment 2 |
+/// +-----------+      +-----------+      +-----------+
+///  ^ readerIndex                             ^ writerIndex
+/// @endcode
+///
+/// Large slices may be sent with MSG_ZEROCOPY instead, see
+/// @c setZeroCopyThreshold.
+///
+/// Not thread safe, access it in the owner loop thread.
+class ChainBuffer {
+ public:
+  static const size_t kSegmentSize = 16 * 1024;
+  static const int kMaxIovecs = 64;
+  static const size_t kMaxCopySliceSize = 256;
+
+  /// @param pool the source of the segment blocks, which are allocated &
+  /// freed by std::vector if it's nullptr.
+  explicit ChainBuffer(BufferPool* pool = nullptr);
+  ~ChainBuffer();
+
+  // Disallow copy.
+  ChainBuffer(const ChainBuffer&) noexcept = delete;
+  ChainBuffer& operator=(const ChainBuffer&) noexcept = delete;
+
+  // Disallow move.
+  ChainBuffer(ChainBuffer&&) noexcept = delete;
+  ChainBuffer& operator=(ChainBuffer&&) noexcept = delete;
+
+  [[nodiscard]] size_t readableBytes() const { return readableBytes_; }
+
+  [[nodiscard]] size_t numSegments() const { return segments_.size(); }
+
+  void append(const std::string_view& str) { append(str.data(), str.size()); }
+
+  void append(const char* /*restrict*/ data, size_t len);
+
+  void append(const void* /*restrict*/ data, size_t len) {
+    append(static_cast<const char*>(data), len);
+  }
+
+  void append(Slice&& slice);
+
+  /// Queues @c length bytes of the file starting at @c offset.
+  ///
+  /// It takes the ownership of @c fd, which is closed after the region is
+  /// retrieved. @c offset is ignored if @c fd is a pipe.
+  void appendFile(int fd, off_t offset, size_t length);
+
+  void retrieve(size_t len);
+
+  /// Drops all the queued bytes & gives the segments back to the pool.
+  void retrieveAll();
+
+  std::string retrieveAllAsString();
+
+  /// Write queued data directly into fd.
+  ///
+  /// It gathers up to @c kMaxIovecs segments with writev(2), and retrieves the
+  /// written bytes. A file region at the front is sent alone with sendfile(2),
+  /// so is a zero-copy slice with sendmsg(2).
+  /// @return result of writev(2), @c errno is saved
+  ssize_t writeFd(int fd, int* savedErrno);
+
+  /// The pipe at the front if it has nothing to read yet, -1 otherwise.
+  ///
+  /// splice(2) fails with EAGAIN on an empty pipe even though @c fd of
+  /// @c writeFd is writable, so poll the pipe for readable before writing.
+  [[nodiscard]] int emptyPipe() const;
+
+  /// Sends a slice of at least @c threshold bytes at the front with
+  /// MSG_ZEROCOPY in @c writeFd, 0 to disable. The slice is held until
+  /// @c releaseZeroCopied is called with the completion of its send.
+  /// SO_ZEROCOPY must be enabled on the fd.
+  void setZeroCopyThreshold(size_t threshold) {
+    zeroCopyThreshold_ = threshold;
+  }
+
+  [[nodiscard]] size_t zeroCopyThreshold() const { return zeroCopyThreshold_; }
+
+  /// Releases the slices of the zero-copy sends numbered [lo, hi], once the
+  /// kernel reports it's done with them. The completions may come out of
+  /// order, a slice is held until the sends before it complete too.
+  void releaseZeroCopied(uint32_t lo, uint32_t hi);
+
+  /// Number of zero-copy sends not completed yet.
+  [[nodiscard]] size_t numZeroCopyPending() const {
+    return zeroCopyPending_.size();
+  }
+
+ private:
+  struct Segment {
+    // Pooled storage, or empty if the segment refers to `slice` or `file`.
+    std::vector<char> block;
+    Slice slice;
+    // The file region starts at `fileOffset`, owned fd or -1.
+    int file{-1};
+    off_t fileOffset{0};
+    bool isPipe{false};
+    size_t readerIndex{0};
+    size_t writerIndex{0};
+
+    [[nodiscard]] const char* data() const {
+      return !block.empty() ? block.data() : slice.data();
+    }
+  };
+
+  struct ZeroCopySend {
+    uint32_t id;
+    Slice slice;
+    bool completed{false};
+  };
+
+  [[nodiscard]] bool isZeroCopyable(const Segment& segment) const {
+    return zeroCopyThreshold_ != 0 && segment.block.empty() &&
+           segment.file < 0 &&
+           segment.writerIndex - segment.readerIndex >= zeroCopyThreshold_;
+  }
+  ssize_t writeFile(int fd, Segment* segment, int* savedErrno);
+  ssize_t writeZeroCopy(int fd, const Segment& segment, int* savedErrno);
+  void appendSegment();
+  void releaseSegment(Segment* segment);
+
+  BufferPool* pool_;
+  std::deque<Segment> segments_;
+  size_t readableBytes_{0};
+  size_t zeroCopyThreshold_{0};
+  // Numbered as the kernel does, consecutive from the front.
+  uint32_t nextZeroCopyId_{0};
+  std::deque<ZeroCopySend> zeroCopyPending_;
+};
+
+}  // namespace net
+}  // namespace jinduo
@@ -0,0 +1,346 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/chain_buffer.h"
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "one/jinduo/net/internal/buffer_pool.h"
+#include "one/jinduo/net/internal/sockets_ops.h"
+
+using jinduo::net::BufferPool;
+using jinduo::net::ChainBuffer;
+
+TEST(ChainBuffer, AppendRetrieve) {
+  ChainBuffer buf;
+  EXPECT_EQ(buf.readableBytes(), 0);
+  EXPECT_EQ(buf.numSegments(), 0);
+
+  const std::string str(200, 'x');
+  buf.append(str);
+  EXPECT_EQ(buf.readableBytes(), str.size());
+  EXPECT_EQ(buf.numSegments(), 1);
+
+  buf.retrieve(50);
+  EXPECT_EQ(buf.readableBytes(), 150);
+  EXPECT_EQ(buf.numSegments(), 1);
+
+  buf.append(str);
+  EXPECT_EQ(buf.retrieveAllAsString(), std::string(350, 'x'));
+  EXPECT_EQ(buf.readableBytes(), 0);
+  EXPECT_EQ(buf.numSegments(), 0);
+}
+
+TEST(ChainBuffer, AppendAcrossSegments) {
+  ChainBuffer buf;
+  std::string str;
+  for (size_t i = 0; i < 2 * ChainBuffer::kSegmentSize + 100; ++i) {
+    str.push_back(static_cast<char>('a' + i % 26));
+  }
+  buf.append(str);
+  EXPECT_EQ(buf.readableBytes(), str.size());
+  EXPECT_EQ(buf.numSegments(), 3);
+
+  // Drop the whole first segment & part of the second one.
+  buf.retrieve(ChainBuffer::kSegmentSize + 10);
+  EXPECT_EQ(buf.numSegments(), 2);
+  EXPECT_EQ(buf.retrieveAllAsString(),
+            str.substr(ChainBuffer::kSegmentSize + 10));
+}
+
+TEST(ChainBuffer, RecycleSegments) {
+  BufferPool pool;
+  const size_t kSize = ChainBuffer::kSegmentSize;
+  {
+    ChainBuffer buf(&pool);
+    buf.append(std::string(3 * kSize, 'y'));
+    EXPECT_EQ(pool.outstanding_blocks(kSize), 3);
+    EXPECT_EQ(pool.free_blocks(kSize), 0);
+
+    buf.retrieve(kSize);
+    EXPECT_EQ(pool.outstanding_blocks(kSize), 2);
+    EXPECT_EQ(pool.free_blocks(kSize), 1);
+
+    // Reuse the recycled one.
+    buf.append(std::string(kSize, 'z'));
+    EXPECT_EQ(pool.outstanding_blocks(kSize), 3);
+    EXPECT_EQ(pool.free_blocks(kSize), 0);
+  }
+  EXPECT_EQ(pool.outstanding_blocks(kSize), 0);
+  EXPECT_EQ(pool.free_blocks(kSize), 3);
+}
+
+TEST(BufferPool, SizeClasses) {
+  BufferPool pool;
+  std::vector<char> block = pool.Allocate(1000);
+  EXPECT_EQ(block.size(), 1024);
+  pool.Deallocate(std::move(block), 1000);
+  block = pool.Allocate(5000);
+  EXPECT_EQ(block.size(), 16 * 1024);
+  EXPECT_EQ(pool.outstanding_blocks(16 * 1024), 1);
+
+  // A grown block is filed under the class it could serve.
+  block.resize(70 * 1024);
+  pool.Deallocate(std::move(block), 5000);
+  EXPECT_EQ(pool.free_blocks(64 * 1024), 1);
+  // Accounted to the class it's allocated from.
+  EXPECT_EQ(pool.outstanding_blocks(16 * 1024), 0);
+  EXPECT_EQ(pool.outstanding_blocks(64 * 1024), 0);
+  block = pool.Allocate(64 * 1024);
+  EXPECT_EQ(block.size(), 64 * 1024);
+
+  // Blocks grew far beyond their class are not kept.
+  block.resize(200 * 1024);
+  pool.Deallocate(std::move(block), 64 * 1024);
+  EXPECT_EQ(pool.free_blocks(64 * 1024), 0);
+  EXPECT_EQ(pool.outstanding_blocks(64 * 1024), 0);
+
+  // Blocks shrunk below the smallest class are dropped, but accounted too.
+  block = pool.Allocate(1000);
+  block.resize(100);
+  block.shrink_to_fit();
+  pool.Deallocate(std::move(block), 1000);
+  EXPECT_EQ(pool.free_blocks(1024), 0);
+  EXPECT_EQ(pool.outstanding_blocks(1024), 0);
+
+  std::vector<jinduo::net::BufferPoolStats> stats = pool.GetStats();
+  ASSERT_EQ(stats.size(), BufferPool::kNumSizeClasses);
+  EXPECT_EQ(stats[3].block_size, 64 * 1024);
+  EXPECT_EQ(stats[3].hits, 1);
+  EXPECT_EQ(stats[0].misses, 1);
+}
+
+TEST(ChainBuffer, WriteFd) {
+  int fds[2];
+  ASSERT_EQ(::pipe2(fds, O_NONBLOCK | O_CLOEXEC), 0);
+
+  ChainBuffer buf;
+  std::string str;
+  for (size_t i = 0; i < ChainBuffer::kSegmentSize + 1000; ++i) {
+    str.push_back(static_cast<char>('0' + i % 10));
+  }
+  buf.append(str);
+
+  int savedErrno = 0;
+  ssize_t n = buf.writeFd(fds[1], &savedErrno);
+  ASSERT_EQ(n, static_cast<ssize_t>(str.size()));
+  EXPECT_EQ(buf.readableBytes(), 0);
+
+  std::string received(str.size(), '\0');
+  ASSERT_EQ(::read(fds[0], received.data(), received.size()),
+            static_cast<ssize_t>(str.size()));
+  EXPECT_EQ(received, str);
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST(ChainBuffer, AppendSlice) {
+  auto bytes = std::make_shared<const jinduo::net::Bytes>(
+      ChainBuffer::kSegmentSize, 's');
+  ChainBuffer buf;
+  buf.append("head");
+  buf.append(jinduo::net::Slice(bytes));
+  EXPECT_EQ(buf.numSegments(), 2);
+  EXPECT_EQ(buf.readableBytes(), bytes->size() + 4);
+  // The payload is shared instead of being copied.
+  EXPECT_EQ(bytes.use_count(), 2);
+
+  // Small slices are copied into the tail segment.
+  buf.append(jinduo::net::Slice::fromString("tail"));
+  EXPECT_EQ(buf.numSegments(), 3);
+  buf.append("more");
+  EXPECT_EQ(buf.numSegments(), 3);
+
+  buf.retrieve(4 + bytes->size() - 1);
+  EXPECT_EQ(bytes.use_count(), 2);
+  buf.retrieve(1);
+  EXPECT_EQ(bytes.use_count(), 1);
+  EXPECT_EQ(buf.retrieveAllAsString(), "tailmore");
+}
+
+TEST(ChainBuffer, AppendFile) {
+  char path[] = "/tmp/chain_buffer_test_XXXXXX";
+  int file = ::mkstemp(path);
+  ASSERT_GE(file, 0);
+  ::unlink(path);
+  std::string content;
+  for (size_t i = 0; i < 3 * ChainBuffer::kSegmentSize; ++i) {
+    content.push_back(static_cast<char>('A' + i % 26));
+  }
+  ASSERT_EQ(::write(file, content.data(), content.size()),
+            static_cast<ssize_t>(content.size()));
+
+  int fds[2];
+  ASSERT_EQ(::pipe2(fds, O_NONBLOCK | O_CLOEXEC), 0);
+  ::fcntl(fds[1], F_SETPIPE_SZ, 1024 * 1024);
+
+  ChainBuffer buf;
+  buf.append("head");
+  buf.appendFile(file, 10, 2 * ChainBuffer::kSegmentSize);
+  buf.append("tail");
+  EXPECT_EQ(buf.readableBytes(), 2 * ChainBuffer::kSegmentSize + 8);
+
+  // The file region is flushed in order with the data around it.
+  int savedErrno = 0;
+  while (buf.readableBytes() > 0) {
+    ASSERT_GT(buf.writeFd(fds[1], &savedErrno), 0);
+  }
+  std::string expected =
+      "head" + content.substr(10, 2 * ChainBuffer::kSegmentSize) + "tail";
+  std::string received(expected.size(), '\0');
+  ASSERT_EQ(::read(fds[0], received.data(), received.size()),
+            static_cast<ssize_t>(expected.size()));
+  EXPECT_EQ(received, expected);
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+namespace {
+
+// MSG_ZEROCOPY needs a TCP socket, connect over loopback. The sender is -1 if
+// SO_ZEROCOPY is not supported.
+void ConnectZeroCopy(int* sender, int* receiver) {
+  int listener = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ASSERT_GE(listener, 0);
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addrlen = sizeof addr;
+  ASSERT_EQ(::bind(listener, reinterpret_cast<sockaddr*>(&addr), addrlen), 0);
+  ASSERT_EQ(::listen(listener, 1), 0);
+  ASSERT_EQ(
+      ::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addrlen), 0);
+  *sender = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ASSERT_EQ(::connect(*sender, reinterpret_cast<sockaddr*>(&addr), addrlen),
+            0);
+  *receiver = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+  ASSERT_GE(*receiver, 0);
+  ::close(listener);
+  int one = 1;
+  if (::setsockopt(*sender, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof one) != 0) {
+    ::close(*sender);
+    ::close(*receiver);
+    *sender = -1;
+    return;
+  }
+  ::fcntl(*sender, F_SETFL, O_NONBLOCK);
+}
+
+}  // namespace
+
+TEST(ChainBuffer, WriteZeroCopy) {
+  int sender = -1;
+  int receiver = -1;
+  ASSERT_NO_FATAL_FAILURE(ConnectZeroCopy(&sender, &receiver));
+  if (sender < 0) {
+    GTEST_SKIP() << "SO_ZEROCOPY is not supported";
+  }
+
+  auto bytes = std::make_shared<const jinduo::net::Bytes>(
+      4 * ChainBuffer::kSegmentSize, 'z');
+  ChainBuffer buf;
+  buf.setZeroCopyThreshold(ChainBuffer::kSegmentSize);
+  buf.append("head");
+  buf.append(jinduo::net::Slice(bytes));
+  buf.append("tail");
+
+  std::string expected = "head" + *bytes + "tail";
+  std::string received;
+  char chunk[64 * 1024];
+  int savedErrno = 0;
+  while (received.size() < expected.size()) {
+    if (buf.readableBytes() > 0) {
+      ASSERT_TRUE(buf.writeFd(sender, &savedErrno) > 0 ||
+                  savedErrno == EAGAIN);
+    }
+    ssize_t n = ::read(receiver, chunk, sizeof chunk);
+    if (n > 0) {
+      received.append(chunk, n);
+    }
+  }
+  EXPECT_EQ(received, expected);
+
+  // The payload is held until the kernel reports it's done with it.
+  ASSERT_GE(buf.numZeroCopyPending(), 1);
+  EXPECT_GT(bytes.use_count(), 1);
+  while (buf.numZeroCopyPending() > 0) {
+    struct pollfd pfd {
+      sender, 0, 0
+    };
+    ASSERT_EQ(::poll(&pfd, 1, 1000), 1);
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+    bool copied = false;
+    while (jinduo::net::sockets::recvZeroCopyCompletion(sender, &lo, &hi,
+                                                         &copied)) {
+      buf.releaseZeroCopied(lo, hi);
+    }
+  }
+  EXPECT_EQ(bytes.use_count(), 1);
+
+  ::close(sender);
+  ::close(receiver);
+}
+
+TEST(ChainBuffer, ReleaseZeroCopiedOutOfOrder) {
+  int sender = -1;
+  int receiver = -1;
+  ASSERT_NO_FATAL_FAILURE(ConnectZeroCopy(&sender, &receiver));
+  if (sender < 0) {
+    GTEST_SKIP() << "SO_ZEROCOPY is not supported";
+  }
+
+  auto bytes = std::make_shared<const jinduo::net::Bytes>(
+      ChainBuffer::kSegmentSize, 'z');
+  ChainBuffer buf;
+  buf.setZeroCopyThreshold(ChainBuffer::kSegmentSize);
+  for (int i = 0; i < 3; ++i) {
+    buf.append(jinduo::net::Slice(bytes));
+  }
+  int savedErrno = 0;
+  while (buf.readableBytes() > 0) {
+    ASSERT_GT(buf.writeFd(sender, &savedErrno), 0);
+  }
+  ASSERT_EQ(buf.numZeroCopyPending(), 3);
+
+  // The later sends completing first don't release the earliest one.
+  buf.releaseZeroCopied(2, 2);
+  buf.releaseZeroCopied(1, 1);
+  EXPECT_EQ(buf.numZeroCopyPending(), 3);
+  // A range wrapping around, as wide as it gets.
+  buf.releaseZeroCopied(1, 0xffffffff);
+  EXPECT_EQ(buf.numZeroCopyPending(), 3);
+  buf.releaseZeroCopied(0xfffffff0, 0);
+  EXPECT_EQ(buf.numZeroCopyPending(), 0);
+  EXPECT_EQ(bytes.use_count(), 1);
+
+  ::close(sender);
+  ::close(receiver);
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is a public header file, it must only include public header files.
+
+#pragma once
+
+#include <cstdint>
+
+#include "absl/time/time.h"
+
+namespace jinduo {
+namespace net {
+
+// Counters & times of a `TcpConnection`, since it's created. The times have
+// the resolution of a loop iteration.
+struct ConnectionStats {
+  int64_t bytes_received{0};
+  int64_t bytes_sent{0};
+  // Syscalls reading & writing the socket, including the ones finding it
+  // drained or full.
+  int64_t reads{0};
+  int64_t writes{0};
+  // Writes leaving bytes in the output queue, to be flushed once the socket
+  // is writable again.
+  int64_t partial_writes{0};
+  // The longest the output queue has been, in bytes.
+  int64_t max_queued_bytes{0};
+  // Time spent waiting for the socket to be writable with bytes queued, i.e.
+  // the peer or the network is slower than the sender.
+  absl::Duration write_blocked_time;
+  absl::Time creation_time;
+  // The last read or write of some bytes, or the creation time if none.
+  absl::Time last_read_time;
+  absl::Time last_write_time;
+};
+
+}  // namespace net
+}  // namespace jinduo
@@ -36,8 +36,11 @@
 #include "absl/time/clock.h"
 #include "glog/logging.h"
 #include "glog/vlog_is_on.h"
+#include "one/jinduo/net/internal/buffer_pool.h"
 #include "one/jinduo/net/internal/channel.h"
+#include "one/jinduo/net/internal/mpsc_queue.h"
 #include "one/jinduo/net/internal/poller.h"
+#include "one/jinduo/net/internal/seqlock.h"
 #include "one/jinduo/net/internal/sockets_ops.h"
 #include "one/jinduo/net/internal/timer_queue.h"
 
@@ -78,11 +81,15 @@ EventLoop* EventLoop::GetCurrentThreadEventLoop() {
 }
 
 EventLoop::EventLoop()
-    : thread_id_(this_thread::tid()),
+    : published_stats_(new SeqLock<EventLoopStats>()),
+      thread_id_(this_thread::tid()),
       poller_(Poller::CreateDefaultPoller(this)),
       timer_queue_(new TimerQueue(this)),
       wakeup_fd_(CreateEventFd()),
-      wakeup_channel_(new Channel(this, wakeup_fd_)) {
+      wakeup_channel_(new Channel(this, wakeup_fd_)),
+      buffer_pool_(new BufferPool()),
+      read_scratch_(new char[kReadScratchSize]),
+      pending_functors_(new MpscQueue<PendingFunctor>()) {
   VLOG(1) << "EventLoop created " << this << " in thread " << thread_id_;
   if (this_thread_event_loop != nullptr) {
     LOG(FATAL) << "Another EventLoop " << this_thread_event_loop
@@ -102,6 +109,13 @@ EventLoop::~EventLoop() {
   wakeup_channel_->DisableAll();
   wakeup_channel_->RemoveFromOwnerEventLoop();
   ::close(wakeup_fd_);
+  // Drop the functors never run.
+  PendingFunctor* node = pending_functors_->PopAll();
+  while (node != nullptr) {
+    PendingFunctor* next = node->mpsc_next;
+    delete node;
+    node = next;
+  }
   this_thread_event_loop = nullptr;
 }
 
@@ -111,16 +125,31 @@ void EventLoop::Loop() {
   looping_ = true;
   VLOG(1) << "EventLoop " << this << " start looping";
 
+  // Busy polling lasts until this time, renewed whenever there's something
+  // to do.
+  absl::Time spin_deadline = absl::InfinitePast();
+  // The end of an iteration is the start of the next one.
+  absl::Time iteration_start = absl::Now();
+
   absl::MutexLock quit_lock(&quit_mutex_);
   while (!quit_) {
     quit_mutex_.Unlock();
     active_channels_.clear();
-    absl::Time poll_return_time = poller_->Poll(kPollTimeMs, &active_channels_);
-    {
-      absl::WriterMutexLock lock(&poll_return_time_mutex_);
-      poll_return_time_ = poll_return_time;
+    const int timeout_ms = NextPollTimeoutMs(iteration_start, spin_deadline);
+    absl::Time poll_return_time = poller_->Poll(timeout_ms, &active_channels_);
+    stats_.poll_return_time = poll_return_time;
+    stats_.poll_time += poll_return_time - iteration_start;
+    ++stats_.iteration;
+    const bool idle = active_channels_.empty() && pending_functors_->empty();
+    if (timeout_ms == 0) {
+      ++stats_.spin_iterations;
+      if (idle) {
+        ++stats_.idle_spin_iterations;
+      }
+    }
+    if (!idle) {
+      spin_deadline = poll_return_time + busy_poll_budget();
     }
-    iteration_.fetch_add(1, std::memory_order_acq_rel);
 
     if (VLOG_IS_ON(1)) {
       for (const Channel* channel : active_channels_) {
@@ -131,14 +160,24 @@ void EventLoop::Loop() {
     // TODO(chenshuo): sort channel by priority
 
     handling_events_.store(true, std::memory_order_release);
+    absl::Time handler_start = poll_return_time;
     for (Channel* channel : active_channels_) {
       current_active_channel_ = channel;
       current_active_channel_->HandleEvent(poll_return_time);
+      absl::Time handler_end = absl::Now();
+      stats_.max_handler_latency =
+          std::max(stats_.max_handler_latency, handler_end - handler_start);
+      handler_start = handler_end;
     }
     current_active_channel_ = nullptr;
     handling_events_.store(false, std::memory_order_release);
+    stats_.events_handled += static_cast<int64_t>(active_channels_.size());
+
+    stats_.functors_run += InvokePendingFunctors();
 
-    InvokePendingFunctors();
+    iteration_start = absl::Now();
+    stats_.handler_time += iteration_start - poll_return_time;
+    published_stats_->Store(stats_);
     quit_mutex_.Lock();
   }
 
@@ -146,6 +185,22 @@ void EventLoop::Loop() {
   looping_ = false;
 }
 
+int EventLoop::NextPollTimeoutMs(absl::Time now, absl::Time spin_deadline) {
+  if (busy_poll_budget_ns_.load(std::memory_order_relaxed) > 0 &&
+      now < spin_deadline) {
+    spinning_.store(true, std::memory_order_relaxed);
+    return 0;
+  }
+  if (!spinning_.load(std::memory_order_relaxed)) {
+    return kPollTimeMs;
+  }
+  // Pairs with the fence in `PushPendingFunctors`, either the producer sees
+  // the loop is about to block & wakes it up, or the loop sees the functor.
+  spinning_.store(false, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return pending_functors_->empty() ? kPollTimeMs : 0;
+}
+
 void EventLoop::Quit() {
   // There is a chance that loop() just executes while(!quit_) and exits,
   // then EventLoop destructs, then we are accessing an invalid object.
@@ -169,34 +224,71 @@ void EventLoop::RunInLoop(Functor cb) {
 }
 
 void EventLoop::QueueInLoop(Functor cb) {
-  {
-    absl::MutexLock lock(&mutex_);
-    pending_functors_.emplace_back(std::move(cb));
+  auto* node = new PendingFunctor{std::move(cb)};
+  PushPendingFunctors(node, node, 1);
+}
+
+void EventLoop::QueueInLoopBatch(std::vector<Functor> cbs) {
+  if (cbs.empty()) {
+    return;
+  }
+  // Link from the newest one to the oldest one.
+  PendingFunctor* last = new PendingFunctor{std::move(cbs.front())};
+  PendingFunctor* first = last;
+  for (size_t i = 1; i < cbs.size(); ++i) {
+    first = new PendingFunctor{std::move(cbs[i]), first};
   }
+  PushPendingFunctors(first, last, cbs.size());
+}
+
+void EventLoop::RunAtIterationEnd(Functor cb) {
+  AssertInLoopThread();
+  iteration_end_functors_.push_back(std::move(cb));
+}
 
-  if (!IsInLoopThread() ||
-      calling_pending_functors_.load(std::memory_order_acquire)) {
+void EventLoop::PushPendingFunctors(PendingFunctor* first,
+                                    PendingFunctor* last, size_t count) {
+  pending_functors_count_.fetch_add(count, std::memory_order_relaxed);
+  const bool was_empty = pending_functors_->PushChain(first, last);
+  // The loop is woken up by whoever queued the first pending functor, unless
+  // it's handling events in the loop thread, which means the functors are
+  // run before polling again, or it's busy polling.
+  if (!was_empty || (IsInLoopThread() &&
+                     handling_events_.load(std::memory_order_acquire))) {
+    return;
+  }
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!spinning_.load(std::memory_order_relaxed)) {
     Wakeup();
   }
 }
 
 size_t EventLoop::queue_size() const {
-  absl::MutexLock lock(&mutex_);
-  return pending_functors_.size();
+  return pending_functors_count_.load(std::memory_order_relaxed);
 }
 
-TimerId EventLoop::RunAt(absl::Time time, TimerCallback cb) {
-  return timer_queue_->addTimer(std::move(cb), time, absl::ZeroDuration());
+EventLoopStats EventLoop::stats() const { return published_stats_->Load(); }
+
+std::vector<BufferPoolStats> EventLoop::buffer_pool_stats() const {
+  return buffer_pool_->GetStats();
 }
 
-TimerId EventLoop::RunAfter(absl::Duration delay, TimerCallback cb) {
+TimerId EventLoop::RunAt(absl::Time time, TimerCallback cb,
+                         absl::Duration slack) {
+  return timer_queue_->addTimer(std::move(cb), time, absl::ZeroDuration(),
+                                slack);
+}
+
+TimerId EventLoop::RunAfter(absl::Duration delay, TimerCallback cb,
+                            absl::Duration slack) {
   absl::Time time = absl::Now() + delay;
-  return RunAt(time, std::move(cb));
+  return RunAt(time, std::move(cb), slack);
 }
 
-TimerId EventLoop::RunEvery(absl::Duration interval, TimerCallback cb) {
+TimerId EventLoop::RunEvery(absl::Duration interval, TimerCallback cb,
+                            absl::Duration slack) {
   absl::Time time = absl::Now() + interval;
-  return timer_queue_->addTimer(std::move(cb), time, interval);
+  return timer_queue_->addTimer(std::move(cb), time, interval, slack);
 }
 
 void EventLoop::CancelTimer(TimerId timer_id) {
@@ -226,6 +318,10 @@ bool EventLoop::HasChannel(Channel* channel) {
   return poller_->HasChannel(channel);
 }
 
+bool EventLoop::SupportsEdgeTriggered() const {
+  return poller_->SupportsEdgeTriggered();
+}
+
 void EventLoop::AbortIfNotInLoopThread() {
   LOG(FATAL) << "EventLoop::abortNotInLoopThread - EventLoop " << this
              << " was created in threadId_ = " << thread_id_
@@ -240,32 +336,48 @@ void EventLoop::Wakeup() {  // NOLINT(readability-make-member-function-const)
   }
 }
 
-void EventLoop::
-    HandleRead() {  // NOLINT(readability-make-member-function-const)
+void EventLoop::HandleRead() {
   uint64_t one = 1;
   ssize_t n = sockets::read(wakeup_fd_, &one, sizeof(one));
   if (n != sizeof(one)) {
     LOG(ERROR) << "EventLoop::HandleRead() reads " << n
                << " bytes instead of 8";
+    return;
   }
+  // The eventfd sums up the writes since the last read.
+  stats_.wakeups += static_cast<int64_t>(one);
 }
 
-void EventLoop::InvokePendingFunctors() {
+int64_t EventLoop::InvokePendingFunctors() {
   calling_pending_functors_.store(true, std::memory_order_release);
 
-  std::vector<Functor> functors;
-  {
-    absl::MutexLock lock(&mutex_);
-    // move & clear to preserve the capacity of `pending_functors_`.
-    functors = std::move(pending_functors_);
-    pending_functors_.clear();
+  // The functors queued while running these ones are left to the next
+  // iteration.
+  int64_t count = 0;
+  PendingFunctor* node = pending_functors_->PopAll();
+  while (node != nullptr) {
+    PendingFunctor* next = node->mpsc_next;
+    pending_functors_count_.fetch_sub(1, std::memory_order_relaxed);
+    node->functor();
+    delete node;
+    node = next;
+    ++count;
   }
 
-  for (const Functor& functor : functors) {
-    functor();
+  // Then the ones deferred to the end of the iteration, which see everything
+  // done above. The ones they defer in turn are run here too, while the
+  // functors they queue are left to the next iteration.
+  while (!iteration_end_functors_.empty()) {
+    running_iteration_end_functors_.swap(iteration_end_functors_);
+    for (Functor& functor : running_iteration_end_functors_) {
+      functor();
+      ++count;
+    }
+    running_iteration_end_functors_.clear();
   }
 
   calling_pending_functors_.store(false, std::memory_order_release);
+  return count;
 }
 
 }  // namespace net
@@ -34,23 +34,35 @@
 #include <vector>
 
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "one/base/small_function.h"
 #include "one/jinduo/base/this_thread.h"
+#include "one/jinduo/net/buffer_pool_stats.h"
 #include "one/jinduo/net/callbacks.h"
+#include "one/jinduo/net/event_loop_stats.h"
 #include "one/jinduo/net/timer_id.h"
 
 namespace jinduo {
 namespace net {
 
+class BufferPool;
 class Channel;
 class Poller;
 class TimerQueue;
+template <typename Node>
+class MpscQueue;
+template <typename T>
+class SeqLock;
+class TcpConnection;
 
 // Reactor, at most one per thread.
 //
 // This is an interface class, so don't expose too much details.
 class EventLoop {
  public:
-  using Functor = std::function<void()>;
+  // Move-only, keeps captures up to 64 bytes inline to save an allocation per
+  // task.
+  using Functor = hcoona::SmallFunction<void()>;
 
   EventLoop();
   ~EventLoop();  // force out-line dtor, for std::unique_ptr members.
@@ -75,6 +87,22 @@ class EventLoop {
   // Quits loop. Call with `shared_ptr<EventLoop>` for thread safety.
   void Quit();
 
+  // Busy polling, trades CPU for latency.
+  //
+  // The loop keeps polling with a zero timeout until nothing happened for
+  // `budget`, then blocks as usual. Meanwhile the threads queueing functors
+  // skip the wakeup. Zero disables it, which is the default.
+  // Safe to call from other threads.
+  void set_busy_poll_budget(absl::Duration budget) {
+    busy_poll_budget_ns_.store(absl::ToInt64Nanoseconds(budget),
+                               std::memory_order_relaxed);
+  }
+
+  absl::Duration busy_poll_budget() const {
+    return absl::Nanoseconds(
+        busy_poll_budget_ns_.load(std::memory_order_relaxed));
+  }
+
   void AssertInLoopThread() {
     if (!IsInLoopThread()) {
       AbortIfNotInLoopThread();
@@ -90,17 +118,38 @@ class EventLoop {
   // Where the event loop is created & running.
   int thread_id() const { return thread_id_; }
 
+  // A consistent snapshot of the loop counters, published once per
+  // iteration. Lock-free & safe to call from any thread, sampling it never
+  // slows down the loop.
+  EventLoopStats stats() const;
+
   // Time when poll returns, usually means data arrival.
-  absl::Time poll_return_time() const {
-    absl::ReaderMutexLock lock(&poll_return_time_mutex_);
-    return poll_return_time_;
+  absl::Time poll_return_time() const { return stats().poll_return_time; }
+
+  int64_t iteration() const { return stats().iteration; }
+
+  // Iterations polled with a zero timeout in busy polling, the others block.
+  int64_t spin_iterations() const { return stats().spin_iterations; }
+
+  // Iterations of busy polling which found nothing to do, burning CPU.
+  int64_t idle_spin_iterations() const { return stats().idle_spin_iterations; }
+
+  size_t queue_size() const;
+
+  // The TCP connections established in this loop & not destroyed yet.
+  // Safe to call in any thread.
+  int64_t num_connections() const {
+    return num_connections_.load(std::memory_order_relaxed);
   }
 
-  int64_t iteration() const {
-    return iteration_.load(std::memory_order_acquire);
+  // Internal use only, by TcpConnection.
+  void UpdateNumConnections(int64_t delta) {
+    num_connections_.fetch_add(delta, std::memory_order_relaxed);
   }
 
-  size_t queue_size() const;
+  // Statistics of the memory pool for the connection buffers, one for each
+  // size class. Safe to call in any thread.
+  std::vector<BufferPoolStats> buffer_pool_stats() const;
 
   bool calling_pending_functors() const {
     return calling_pending_functors_.load(std::memory_order_acquire);
@@ -125,21 +174,39 @@ class EventLoop {
   // Safe to call from other threads.
   void QueueInLoop(Functor cb);
 
+  // Queues callbacks in the loop thread, in order.
+  // It costs a single atomic operation & at most one wakeup for all of them.
+  // Safe to call from other threads.
+  void QueueInLoopBatch(std::vector<Functor> cbs);
+
+  // Runs callback once at the end of the current iteration, after the events
+  // are handled & the pending functors are run, e.g. to flush the writes
+  // batched in this iteration with a single syscall.
+  // Must be called in the loop thread.
+  void RunAtIterationEnd(Functor cb);
+
   //
   // Run tasks with a timer.
   //
 
+  // The timers below may fire up to @c slack late, so that the ones due
+  // around the same time fire in a single wakeup, e.g. heartbeats that don't
+  // care about a few milliseconds.
+
   // Runs callback at 'time'.
   // Safe to call from other threads.
-  TimerId RunAt(absl::Time time, TimerCallback cb);
+  TimerId RunAt(absl::Time time, TimerCallback cb,
+                absl::Duration slack = absl::ZeroDuration());
 
   // Runs callback after @c delay seconds.
   // Safe to call from other threads.
-  TimerId RunAfter(absl::Duration delay, TimerCallback cb);
+  TimerId RunAfter(absl::Duration delay, TimerCallback cb,
+                   absl::Duration slack = absl::ZeroDuration());
 
   // Runs callback every @c interval seconds.
   // Safe to call from other threads.
-  TimerId RunEvery(absl::Duration interval, TimerCallback cb);
+  TimerId RunEvery(absl::Duration interval, TimerCallback cb,
+                   absl::Duration slack = absl::ZeroDuration());
 
   // Cancels the timer.
   // Safe to call from other threads.
@@ -163,11 +230,36 @@ class EventLoop {
   void UpdateChannel(Channel* channel);
   void RemoveChannel(Channel* channel);
   bool HasChannel(Channel* channel);
+  bool SupportsEdgeTriggered() const;
+
+  // Memory blocks for buffers of the connections living in this loop.
+  BufferPool* buffer_pool() { return buffer_pool_.get(); }
+
+  // Scratch memory shared by the reads of the connections living in this loop,
+  // the bytes are copied out before the next read.
+  static constexpr size_t kReadScratchSize = 256 * 1024;
+  char* read_scratch() { return read_scratch_.get(); }
 
  private:
+  // Sums up its counters into mutable_stats().
+  friend class TcpConnection;
+
+  struct PendingFunctor {
+    Functor functor;
+    PendingFunctor* mpsc_next{nullptr};
+  };
+
   void AbortIfNotInLoopThread();
   void HandleRead();  // waked up
-  void InvokePendingFunctors();
+  // In the loop thread, the counters are published along with the loop ones.
+  EventLoopStats* mutable_stats() { return &stats_; }
+  // Returns the number of functors run.
+  int64_t InvokePendingFunctors();
+  // Returns 0 to keep busy polling before `spin_deadline`, or the blocking
+  // timeout otherwise.
+  int NextPollTimeoutMs(absl::Time now, absl::Time spin_deadline);
+  void PushPendingFunctors(PendingFunctor* first, PendingFunctor* last,
+                           size_t count);
 
   //
   // Looping control
@@ -178,16 +270,21 @@ class EventLoop {
   mutable absl::Mutex quit_mutex_;
   bool quit_ ABSL_GUARDED_BY(quit_mutex_){false};
 
+  std::atomic<int64_t> busy_poll_budget_ns_{0};
+  // True while the loop polls with a zero timeout, so no need to wake it up.
+  std::atomic<bool> spinning_{false};
+
   //
   // Expose internal status.
   //
 
   std::atomic<bool> handling_events_{false};
   std::atomic<bool> calling_pending_functors_{false};
-  std::atomic<int64_t> iteration_{0};
-  // TODO(zhangshuai.ustc): RCU?
-  mutable absl::Mutex poll_return_time_mutex_;
-  absl::Time poll_return_time_ ABSL_GUARDED_BY(poll_return_time_mutex_);
+  std::atomic<int64_t> num_connections_{0};
+  // Counted in the loop thread, then published for the other threads, which
+  // only read the copy.
+  EventLoopStats stats_;  // Assert access in loop.
+  std::unique_ptr<SeqLock<EventLoopStats>> published_stats_;
 
   //
   // Event-queue members
@@ -200,6 +297,8 @@ class EventLoop {
   // unlike in TimerQueue, which is an internal class,
   // we don't expose Channel to client.
   std::unique_ptr<Channel> wakeup_channel_;
+  std::unique_ptr<BufferPool> buffer_pool_;
+  std::unique_ptr<char[]> read_scratch_;
 
   //
   // Context
@@ -211,8 +310,12 @@ class EventLoop {
   std::vector<Channel*> active_channels_;     // Assert access in loop.
   Channel* current_active_channel_{nullptr};  // Assert access in loop.
 
-  mutable absl::Mutex mutex_;
-  std::vector<Functor> pending_functors_ ABSL_GUARDED_BY(mutex_);
+  // Lock-free, only the first functor queued after a drain wakes up the loop.
+  std::unique_ptr<MpscQueue<PendingFunctor>> pending_functors_;
+  std::atomic<size_t> pending_functors_count_{0};
+  // Assert access in loop, the running ones are kept to reuse the storage.
+  std::vector<Functor> iteration_end_functors_;
+  std::vector<Functor> running_iteration_end_functors_;
 };
 
 }  // namespace net
@@ -0,0 +1,111 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/event_loop.h"
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+
+using jinduo::net::EventLoop;
+
+TEST(EventLoop, QueueInLoopBatchKeepsOrder) {
+  EventLoop loop;
+  std::vector<int> order;
+  std::thread thread([&] {
+    loop.QueueInLoop([&] { order.push_back(1); });
+    std::vector<EventLoop::Functor> batch;
+    for (int i = 2; i <= 4; ++i) {
+      batch.push_back([&order, i] { order.push_back(i); });
+    }
+    loop.QueueInLoopBatch(std::move(batch));
+    loop.QueueInLoopBatch({});
+    loop.QueueInLoop([&] {
+      order.push_back(5);
+      loop.Quit();
+    });
+  });
+  loop.Loop();
+  thread.join();
+  EXPECT_EQ((std::vector<int>{1, 2, 3, 4, 5}), order);
+  EXPECT_EQ(0U, loop.queue_size());
+}
+
+TEST(EventLoop, BurstOfQueueInLoopWakesUpOnce) {
+  EventLoop loop;
+  std::promise<void> running;
+  std::promise<void> queued;
+  int count = 0;
+  std::thread thread([&] {
+    // Holds the loop in a functor, so it's not polling during the burst.
+    loop.QueueInLoop([&] {
+      running.set_value();
+      queued.get_future().wait();
+    });
+    running.get_future().wait();
+    for (int i = 0; i < 100; ++i) {
+      loop.QueueInLoop([&] { ++count; });
+    }
+    loop.QueueInLoop([&] { loop.Quit(); });
+    queued.set_value();
+  });
+  loop.Loop();
+  thread.join();
+  EXPECT_EQ(100, count);
+  // One for the functor holding the loop, one for the whole burst.
+  EXPECT_EQ(2, loop.stats().wakeups);
+  EXPECT_EQ(102, loop.stats().functors_run);
+}
+
+TEST(EventLoop, BusyPollingRunsFunctorsFromOtherThreads) {
+  EventLoop loop;
+  loop.set_busy_poll_budget(absl::Milliseconds(5));
+  absl::Duration maxLatency;
+  int count = 0;
+  absl::Time quitTime;
+  std::thread thread([&] {
+    // The gaps straddle the budget, so the functors arrive while it's
+    // spinning, & right as it goes back to blocking.
+    const absl::Duration gaps[] = {absl::ZeroDuration(), absl::Milliseconds(1),
+                                   absl::Milliseconds(5),
+                                   absl::Milliseconds(10)};
+    for (int i = 0; i < 100; ++i) {
+      absl::SleepFor(gaps[i % 4]);
+      const absl::Time queued = absl::Now();
+      loop.QueueInLoop([&, queued] {
+        maxLatency = std::max(maxLatency, absl::Now() - queued);
+        ++count;
+      });
+    }
+    absl::SleepFor(absl::Milliseconds(20));
+    quitTime = absl::Now();
+    loop.Quit();
+  });
+  loop.Loop();
+  const absl::Time loopEnd = absl::Now();
+  thread.join();
+  EXPECT_EQ(100, count);
+  // Far below the blocking poll timeout, none waited for it.
+  EXPECT_LT(maxLatency, absl::Seconds(1));
+  EXPECT_LT(loopEnd - quitTime, absl::Seconds(1));
+  EXPECT_GT(loop.stats().spin_iterations, 0);
+}
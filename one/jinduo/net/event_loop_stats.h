@@ -0,0 +1,62 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is a public header file, it must only include public header files.
+
+#pragma once
+
+#include <cstdint>
+
+#include "absl/time/time.h"
+
+namespace jinduo {
+namespace net {
+
+// A consistent snapshot of the counters of an `EventLoop`, since it starts
+// looping.
+struct EventLoopStats {
+  // Time when poll returns for the last time, usually means data arrival.
+  absl::Time poll_return_time;
+  int64_t iteration{0};
+  // Iterations polled with a zero timeout in busy polling, the others block.
+  int64_t spin_iterations{0};
+  // Iterations of busy polling which found nothing to do, burning CPU.
+  int64_t idle_spin_iterations{0};
+  // Channels whose events are handled.
+  int64_t events_handled{0};
+  int64_t functors_run{0};
+  // Wakeups by writing the eventfd, e.g. for the functors queued from other
+  // threads while polling.
+  int64_t wakeups{0};
+  // Time spent in polling, including blocking.
+  absl::Duration poll_time;
+  // Time spent in handling events & running functors.
+  absl::Duration handler_time;
+  // The slowest event handler.
+  absl::Duration max_handler_latency;
+  // Sums of the counters of the connections living in this loop, the closed
+  // ones included, see `ConnectionStats`.
+  int64_t bytes_received{0};
+  int64_t bytes_sent{0};
+  int64_t reads{0};
+  int64_t writes{0};
+  int64_t partial_writes{0};
+  absl::Duration write_blocked_time;
+};
+
+}  // namespace net
+}  // namespace jinduo
@@ -25,12 +25,17 @@
 
 #include "one/jinduo/net/event_loop_thread.h"
 
+#include <linux/mempolicy.h>
 #include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include <utility>
 
 #include "absl/functional/bind_front.h"
 #include "glog/logging.h"
+#include "one/jinduo/base/strerror.h"
 #include "one/jinduo/net/event_loop.h"
 
 namespace jinduo {
@@ -70,16 +75,7 @@ EventLoop* EventLoopThread::StartLoop() {
 }
 
 void EventLoopThread::ThreadFunc() {
-  static constexpr size_t kThreadNameLengthMax = 15;
-  PLOG_IF(WARNING,
-          pthread_setname_np(
-              thread_->native_handle(),
-              thread_name_.size() < kThreadNameLengthMax
-                  ? thread_name_.c_str()
-                  : std::string(thread_name_.begin(),
-                                thread_name_.begin() + kThreadNameLengthMax)
-                        .c_str()) != 0)
-      << "Failed to set event loop thread name. name=" << thread_name_;
+  SetUpThread();
 
   EventLoop loop;
 
@@ -101,5 +97,46 @@ void EventLoopThread::ThreadFunc() {
   }
 }
 
+void EventLoopThread::SetUpThread() {
+  // Not `thread_->native_handle()`, `thread_` may not be assigned yet.
+  static constexpr size_t kThreadNameLengthMax = 15;
+  int err = pthread_setname_np(
+      pthread_self(), thread_name_.size() < kThreadNameLengthMax
+                          ? thread_name_.c_str()
+                          : std::string(thread_name_.begin(),
+                                        thread_name_.begin() +
+                                            kThreadNameLengthMax)
+                                .c_str());
+  LOG_IF(WARNING, err != 0)
+      << "Failed to set event loop thread name. name=" << thread_name_ << ": "
+      << strerror_tl(err);
+
+  if (!cpus_.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus_) {
+      if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        LOG(WARNING) << "Ignored CPU " << cpu << " out of [0, " << CPU_SETSIZE
+                     << ") for event loop thread affinity. name="
+                     << thread_name_;
+        continue;
+      }
+      CPU_SET(cpu, &cpu_set);
+    }
+    err = pthread_setaffinity_np(pthread_self(), sizeof cpu_set, &cpu_set);
+    LOG_IF(WARNING, err != 0)
+        << "Failed to set event loop thread affinity. name=" << thread_name_
+        << ": " << strerror_tl(err);
+  }
+
+  // No libnuma, the syscall is all we need.
+  if (numa_local_) {
+    PLOG_IF(WARNING,
+            ::syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) != 0)
+        << "Failed to set event loop thread memory policy. name="
+        << thread_name_;
+  }
+}
+
 }  // namespace net
 }  // namespace jinduo
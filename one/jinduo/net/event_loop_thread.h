@@ -31,6 +31,7 @@
 #include <optional>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
@@ -58,10 +59,22 @@ class EventLoopThread {
   EventLoopThread(EventLoopThread&& other) noexcept = delete;
   EventLoopThread& operator=(EventLoopThread&& other) noexcept = delete;
 
+  // Pins the thread to the CPUs, before the loop is created, so the memory
+  // it allocates first is on the local NUMA node. Must call before
+  // `StartLoop()`.
+  void set_cpu_affinity(std::vector<int> cpus) { cpus_ = std::move(cpus); }
+
+  // Allocates the memory of the thread on the node it runs on, overriding the
+  // policy inherited from the process, e.g. `numactl --interleave`. Must call
+  // before `StartLoop()`.
+  void set_numa_local(bool on) { numa_local_ = on; }
+
   EventLoop* StartLoop();
 
  private:
   void ThreadFunc();
+  // Applies the thread name, CPU affinity & memory policy in the thread.
+  void SetUpThread();
 
   absl::Mutex mutex_{};
   absl::CondVar loop_initialized_cv_ ABSL_GUARDED_BY(mutex_){};
@@ -70,6 +83,8 @@ class EventLoopThread {
   ThreadInitCallback callback_{};
   std::optional<std::thread> thread_{};
   std::string thread_name_{};
+  std::vector<int> cpus_{};
+  bool numa_local_{false};
 };
 
 }  // namespace net
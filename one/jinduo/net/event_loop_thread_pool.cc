@@ -25,20 +25,25 @@
 
 #include "one/jinduo/net/event_loop_thread_pool.h"
 
+#include <sched.h>
 #include <stdio.h>
 
+#include <algorithm>
 #include <memory>
 #include <utility>
 #include <vector>
 
 #include "absl/base/casts.h"
 #include "absl/strings/str_cat.h"
+#include "glog/logging.h"
 #include "one/jinduo/net/event_loop.h"
 #include "one/jinduo/net/event_loop_thread.h"
 
 namespace jinduo {
 namespace net {
 
+constexpr absl::Duration EventLoopThreadPool::kBusySampleInterval;
+
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* base_loop, std::string name)
     : base_loop_(base_loop), name_(std::move(name)) {}
 
@@ -53,8 +58,28 @@ void EventLoopThreadPool::Start(const ThreadInitCallback& cb) {
   for (int i = 0; i < num_threads_; ++i) {
     auto* t = new EventLoopThread(cb, absl::StrCat(name_, i));
     threads_.emplace_back(t);
+    int cpu = cpus_.empty() ? -1 : cpus_[i % cpus_.size()];
+    if (cpu >= CPU_SETSIZE) {
+      LOG(WARNING) << "EventLoopThreadPool::Start [" << name_ << "] - CPU "
+                   << cpu << " is out of range, not pinned";
+      cpu = -1;
+    }
+    if (cpu >= 0) {
+      t->set_cpu_affinity({cpu});
+    }
+    t->set_numa_local(numa_local_);
     loops_.emplace_back(t->StartLoop());
+    if (cpu >= 0) {
+      if (absl::implicit_cast<size_t>(cpu) >= loops_by_cpu_.size()) {
+        loops_by_cpu_.resize(cpu + 1);
+      }
+      // The first one if more threads than CPUs.
+      if (loops_by_cpu_[cpu] == nullptr) {
+        loops_by_cpu_[cpu] = loops_.back();
+      }
+    }
   }
+  busy_samples_.resize(loops_.size());
 
   if (num_threads_ == 0 && cb) {
     cb(base_loop_);
@@ -67,12 +92,8 @@ EventLoop* EventLoopThreadPool::GetNextLoop() {
   EventLoop* loop = base_loop_;
 
   if (!loops_.empty()) {
-    // round-robin
-    loop = loops_[next_loop_index_];
-    ++next_loop_index_;
-    if (absl::implicit_cast<size_t>(next_loop_index_) >= loops_.size()) {
-      next_loop_index_ = 0;
-    }
+    loop = loops_[selector_->Select(
+        loops_.size(), [this](size_t index) { return SampleLoad(index); })];
   }
   return loop;
 }
@@ -88,6 +109,14 @@ EventLoop* EventLoopThreadPool::GetLoopForHash(size_t hash_code) {
   return loop;
 }
 
+EventLoop* EventLoopThreadPool::GetLoopForCpu(int cpu) {
+  base_loop_->AssertInLoopThread();
+  if (cpu < 0 || absl::implicit_cast<size_t>(cpu) >= loops_by_cpu_.size()) {
+    return nullptr;
+  }
+  return loops_by_cpu_[cpu];
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::all_loops() {
   base_loop_->AssertInLoopThread();
   assert(started_);
@@ -97,5 +126,28 @@ std::vector<EventLoop*> EventLoopThreadPool::all_loops() {
   return loops_;
 }
 
+LoopLoad EventLoopThreadPool::SampleLoad(size_t index) {
+  EventLoop* loop = loops_[index];
+  LoopLoad load;
+  load.connections = loop->num_connections();
+  load.queue_size = loop->queue_size();
+
+  BusySample& sample = busy_samples_[index];
+  const absl::Time now = absl::Now();
+  if (now - sample.time >= kBusySampleInterval) {
+    const absl::Duration handler_time = loop->stats().handler_time;
+    if (sample.time != absl::InfinitePast()) {
+      sample.busy = std::clamp(absl::FDivDuration(
+                                   handler_time - sample.handler_time,
+                                   now - sample.time),
+                               0.0, 1.0);
+    }
+    sample.time = now;
+    sample.handler_time = handler_time;
+  }
+  load.busy = sample.busy;
+  return load;
+}
+
 }  // namespace net
 }  // namespace jinduo
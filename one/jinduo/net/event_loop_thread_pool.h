@@ -32,6 +32,9 @@
 #include <string>
 #include <vector>
 
+#include "absl/time/time.h"
+#include "one/jinduo/net/loop_selector.h"
+
 namespace jinduo {
 namespace net {
 
@@ -59,27 +62,65 @@ class EventLoopThreadPool {
   // 0 to use `base_loop`, any positive numbers to establish a thread pool with
   // each thread a event loop.
   void set_thread_num(int num_threads) { num_threads_ = num_threads; }
+
+  // Picks the loop in `GetNextLoop()`, round-robin by default. Must call before
+  // `Start()`.
+  void set_loop_selector(std::unique_ptr<LoopSelector> selector) {
+    selector_ = std::move(selector);
+  }
+
+  // Pins the i-th thread to `cpus[i % cpus.size()]`, e.g. the cores of a NUMA
+  // node, or the cores taking the interrupts of the NIC queues. Must call
+  // before `Start()`.
+  void set_cpu_affinity(std::vector<int> cpus) { cpus_ = std::move(cpus); }
+
+  // Allocates the memory of the loops on the local NUMA node of the threads,
+  // see `EventLoopThread::set_numa_local()`. Must call before `Start()`.
+  void set_numa_local(bool on) { numa_local_ = on; }
+
   void Start(const ThreadInitCallback& cb = ThreadInitCallback());
 
-  // Get next loop in a round-robin policy. Must call after `Start()`.
+  // Get next loop by the loop selector. Must call after `Start()`.
   EventLoop* GetNextLoop();
 
   /// Get next loop in a hashing policy. It will always return the same
   /// EventLoop for same hash_code.
   EventLoop* GetLoopForHash(size_t hash_code);
 
+  /// Get the loop pinned to the CPU, nullptr if none, e.g. for the
+  /// SO_INCOMING_CPU of a connection.
+  EventLoop* GetLoopForCpu(int cpu);
+
   std::vector<EventLoop*> all_loops();
 
  private:
+  // The handler time of a loop when it's sampled, for the recent busy time.
+  struct BusySample {
+    absl::Time time{absl::InfinitePast()};
+    absl::Duration handler_time;
+    double busy{0};
+  };
+
+  // The busy time is averaged since the last sample, at least
+  // `kBusySampleInterval` ago.
+  static constexpr absl::Duration kBusySampleInterval = absl::Milliseconds(100);
+
+  LoopLoad SampleLoad(size_t index);
+
   EventLoop* base_loop_;
   std::string name_;
 
   bool started_{false};
   int num_threads_{0};
-  int next_loop_index_{0};
+  std::vector<int> cpus_;
+  bool numa_local_{false};
+  std::unique_ptr<LoopSelector> selector_{LoopSelector::NewRoundRobin()};
 
   std::vector<std::unique_ptr<EventLoopThread>> threads_;
   std::vector<EventLoop*> loops_;
+  std::vector<BusySample> busy_samples_;
+  // Indexed by CPU, only if the threads are pinned.
+  std::vector<EventLoop*> loops_by_cpu_;
 };
 
 }  // namespace net
@@ -25,9 +25,12 @@
 
 #include "one/jinduo/net/event_loop_thread_pool.h"
 
+#include <sched.h>
 #include <stdio.h>
 #include <unistd.h>
 
+#include <vector>
+
 #include "absl/functional/bind_front.h"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
@@ -92,5 +95,19 @@ int main(int argc, char* argv[]) {
     assert(nextLoop == model.GetNextLoop());
   }
 
+  {
+    LOG(INFO) << "Pinned threads (p=" << &loop << ")";
+    EventLoopThreadPool model(&loop, "pinned");
+    model.set_thread_num(3);
+    // The out of range CPU is ignored, the third thread goes to CPU 0 again.
+    model.set_cpu_affinity({0, CPU_SETSIZE + 1});
+    model.Start(init);
+    std::vector<EventLoop*> loops = model.all_loops();
+    assert(model.GetLoopForCpu(0) == loops[0]);
+    assert(model.GetLoopForCpu(1) == nullptr);
+    assert(model.GetLoopForCpu(-1) == nullptr);
+    assert(model.GetLoopForCpu(CPU_SETSIZE + 1) == nullptr);
+  }
+
   loop.Loop();
 }
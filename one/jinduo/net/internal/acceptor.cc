@@ -27,6 +27,7 @@
 
 #include <asm-generic/errno.h>
 #include <fcntl.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 
 #include <atomic>
@@ -71,13 +72,38 @@ void Acceptor::Listen() {
   accept_channel_.EnableReading();
 }
 
+InetAddress Acceptor::GetListenAddress() const {
+  return InetAddress(sockets::getLocalAddr(accept_socket_.fd()));
+}
+
+AcceptStats Acceptor::GetStats() const {
+  AcceptStats stats;
+  stats.accepted = accepted_.load(std::memory_order_relaxed);
+  stats.errors = errors_.load(std::memory_order_relaxed);
+  stats.budget_exhausted =
+      budget_exhausted_count_.load(std::memory_order_relaxed);
+  stats.backlog_full = backlog_full_.load(std::memory_order_relaxed);
+  stats.max_backlog = max_backlog_.load(std::memory_order_relaxed);
+  return stats;
+}
+
 void Acceptor::HandleRead(absl::Time /*receive_time*/) {
   loop_->AssertInLoopThread();
 
+  if (budget_exhausted_) {
+    SampleBacklog();
+  }
+
   InetAddress peer_address;
-  while (true) {
+  int attempts = 0;
+  uint64_t accepted = 0;
+  budget_exhausted_ = true;
+  while (accept_budget_ <= 0 || attempts < accept_budget_) {
+    ++attempts;
+    // Non-blocking & close-on-exec by accept4(2) already.
     int connfd = accept_socket_.accept(&peer_address);
     if (connfd >= 0) {
+      ++accepted;
       if (new_connection_callback_) {
         new_connection_callback_(connfd, peer_address);
       } else {
@@ -85,9 +111,11 @@ void Acceptor::HandleRead(absl::Time /*receive_time*/) {
       }
     } else {
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        budget_exhausted_ = false;
         break;
       }
 
+      errors_.fetch_add(1, std::memory_order_relaxed);
       LOG(ERROR) << "in Acceptor::handleRead";
       // Read the section named "The special problem of
       // accept()ing when you can't" in libev's doc.
@@ -107,6 +135,26 @@ void Acceptor::HandleRead(absl::Time /*receive_time*/) {
       }
     }
   }
+
+  accepted_.fetch_add(accepted, std::memory_order_relaxed);
+  if (budget_exhausted_) {
+    budget_exhausted_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void Acceptor::SampleBacklog() {
+  // For a listening socket, tcpi_unacked is the length of the accept queue &
+  // tcpi_sacked is its capacity.
+  struct tcp_info info {};
+  if (!accept_socket_.getTcpInfo(&info)) {
+    return;
+  }
+  if (info.tcpi_unacked > max_backlog_.load(std::memory_order_relaxed)) {
+    max_backlog_.store(info.tcpi_unacked, std::memory_order_relaxed);
+  }
+  if (info.tcpi_sacked > 0 && info.tcpi_unacked >= info.tcpi_sacked) {
+    backlog_full_.fetch_add(1, std::memory_order_relaxed);
+  }
 }
 
 }  // namespace net
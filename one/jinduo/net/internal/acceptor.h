@@ -28,9 +28,12 @@
 #pragma once
 
 #include <atomic>
-#include <functional>
+#include <cstdint>
+#include <utility>
 
 #include "absl/time/time.h"
+#include "one/base/small_function.h"
+#include "one/jinduo/net/accept_stats.h"
 #include "one/jinduo/net/internal/channel.h"
 #include "one/jinduo/net/internal/socket.h"
 
@@ -44,7 +47,9 @@ class InetAddress;
 class Acceptor {
  public:
   using NewConnectionCallback =
-      std::function<void(int /*fd*/, const InetAddress&)>;
+      hcoona::SmallFunction<void(int /*fd*/, const InetAddress&)>;
+
+  static constexpr int kDefaultAcceptBudget = 64;
 
   Acceptor(EventLoop* loop, const InetAddress& listen_address, bool reuse_port);
   ~Acceptor();
@@ -57,18 +62,30 @@ class Acceptor {
   Acceptor(Acceptor&&) noexcept = delete;
   Acceptor& operator=(Acceptor&&) noexcept = delete;
 
-  void SetNewConnectionCallback(const NewConnectionCallback& cb) {
-    new_connection_callback_ = cb;
+  void SetNewConnectionCallback(NewConnectionCallback cb) {
+    new_connection_callback_ = std::move(cb);
   }
 
+  // Accepts at most `budget` connections per read event, 0 for no limit, so a
+  // connection storm can't starve the established connections of the loop.
+  // The rest are accepted in the next iterations.
+  void set_accept_budget(int budget) { accept_budget_ = budget; }
+
   void Listen();
 
+  // The bound address, with the port picked by the kernel if it was 0.
+  [[nodiscard]] InetAddress GetListenAddress() const;
+
   [[nodiscard]] bool listening() const {
     return listening_.load(std::memory_order_acquire);
   }
 
+  // Thread safe.
+  [[nodiscard]] AcceptStats GetStats() const;
+
  private:
   void HandleRead(absl::Time /*receive_time*/);
+  void SampleBacklog();
 
   EventLoop* loop_;
   Socket accept_socket_;
@@ -76,8 +93,18 @@ class Acceptor {
   int idle_fd_;
 
   NewConnectionCallback new_connection_callback_;
+  int accept_budget_{kDefaultAcceptBudget};
+  // The last read event ran out of budget, sample the backlog on the next one.
+  bool budget_exhausted_{false};
 
   std::atomic<bool> listening_{false};
+
+  // Written in the loop thread only.
+  std::atomic<uint64_t> accepted_{0};
+  std::atomic<uint64_t> errors_{0};
+  std::atomic<uint64_t> budget_exhausted_count_{0};
+  std::atomic<uint64_t> backlog_full_{0};
+  std::atomic<uint32_t> max_backlog_{0};
 };
 
 }  // namespace net
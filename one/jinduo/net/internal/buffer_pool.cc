@@ -0,0 +1,129 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/internal/buffer_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include "one/jinduo/base/this_thread.h"
+
+namespace jinduo {
+namespace net {
+
+BufferPool::BufferPool(size_t max_free_bytes)
+    : owner_thread_id_(this_thread::tid()) {
+  for (size_t i = 0; i < kNumSizeClasses; ++i) {
+    size_classes_[i].block_size = kBlockSizes[i];
+    size_classes_[i].max_free_blocks = max_free_bytes / kBlockSizes[i];
+  }
+}
+
+std::vector<char> BufferPool::Allocate(size_t size) {
+  size_t index = SizeClassOf(size);
+  if (index == kNumSizeClasses) {
+    // Counted as the largest class, the same as `Deallocate()` does.
+    SizeClass& size_class = size_classes_[kNumSizeClasses - 1];
+    size_class.outstanding_blocks.fetch_add(1, std::memory_order_relaxed);
+    size_class.misses.fetch_add(1, std::memory_order_relaxed);
+    return std::vector<char>(size);
+  }
+  SizeClass& size_class = size_classes_[index];
+  size_class.outstanding_blocks.fetch_add(1, std::memory_order_relaxed);
+  if (IsInOwnerThread() && !size_class.free_blocks.empty()) {
+    std::vector<char> block = std::move(size_class.free_blocks.back());
+    size_class.free_blocks.pop_back();
+    size_class.free_blocks_count.store(size_class.free_blocks.size(),
+                                       std::memory_order_relaxed);
+    size_class.hits.fetch_add(1, std::memory_order_relaxed);
+    return block;
+  }
+  size_class.misses.fetch_add(1, std::memory_order_relaxed);
+  return std::vector<char>(size_class.block_size);
+}
+
+void BufferPool::Deallocate(std::vector<char>&& block, size_t allocated_size) {
+  // Counted as the largest class if it's larger, the same as `Allocate()`.
+  size_classes_[std::min(SizeClassOf(allocated_size), kNumSizeClasses - 1)]
+      .outstanding_blocks.fetch_sub(1, std::memory_order_relaxed);
+
+  // Find the largest class the block could serve.
+  size_t index = kNumSizeClasses;
+  while (index > 0 && block.capacity() < kBlockSizes[index - 1]) {
+    --index;
+  }
+  if (index == 0) {
+    std::vector<char>().swap(block);
+    return;
+  }
+  SizeClass& size_class = size_classes_[index - 1];
+  // Don't keep the blocks grew far beyond their class, they waste memory.
+  if (IsInOwnerThread() && block.capacity() < 2 * size_class.block_size &&
+      size_class.free_blocks.size() < size_class.max_free_blocks) {
+    block.resize(size_class.block_size);
+    size_class.free_blocks.emplace_back(std::move(block));
+    size_class.free_blocks_count.store(size_class.free_blocks.size(),
+                                       std::memory_order_relaxed);
+  }
+  std::vector<char>().swap(block);
+}
+
+std::vector<BufferPoolStats> BufferPool::GetStats() const {
+  std::vector<BufferPoolStats> stats(kNumSizeClasses);
+  for (size_t i = 0; i < kNumSizeClasses; ++i) {
+    const SizeClass& size_class = size_classes_[i];
+    stats[i].block_size = size_class.block_size;
+    stats[i].free_blocks =
+        size_class.free_blocks_count.load(std::memory_order_relaxed);
+    stats[i].outstanding_blocks =
+        size_class.outstanding_blocks.load(std::memory_order_relaxed);
+    stats[i].hits = size_class.hits.load(std::memory_order_relaxed);
+    stats[i].misses = size_class.misses.load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+size_t BufferPool::free_blocks(size_t block_size) const {
+  size_t index = SizeClassOf(block_size);
+  assert(index < kNumSizeClasses);
+  return size_classes_[index].free_blocks_count.load(
+      std::memory_order_relaxed);
+}
+
+int64_t BufferPool::outstanding_blocks(size_t block_size) const {
+  size_t index = SizeClassOf(block_size);
+  assert(index < kNumSizeClasses);
+  return size_classes_[index].outstanding_blocks.load(
+      std::memory_order_relaxed);
+}
+
+bool BufferPool::IsInOwnerThread() const {
+  return owner_thread_id_ == this_thread::tid();
+}
+
+// static
+size_t BufferPool::SizeClassOf(size_t size) {
+  size_t index = 0;
+  while (index < kNumSizeClasses && kBlockSizes[index] < size) {
+    ++index;
+  }
+  return index;
+}
+
+}  // namespace net
+}  // namespace jinduo
@@ -0,0 +1,100 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is an internal header file, you should not include this.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "one/jinduo/net/buffer_pool_stats.h"
+
+namespace jinduo {
+namespace net {
+
+// Size-classed free lists of memory blocks owned by an `EventLoop`.
+//
+// A block is a `std::vector<char>` whose size is one of `kBlockSizes`, so it
+// could be adopted by a `Buffer` directly & outlive the pool safely. Blocks
+// are handed out & taken back in the owner loop thread without any locking. A
+// block released from another thread (e.g. the last reference of a
+// `TcpConnection` dropped by a user thread) bypasses the free lists and goes
+// back to the system allocator directly.
+class BufferPool {
+ public:
+  static constexpr size_t kNumSizeClasses = 4;
+  static constexpr std::array<size_t, kNumSizeClasses> kBlockSizes{
+      1024, 4 * 1024, 16 * 1024, 64 * 1024};
+  static constexpr size_t kMaxBlockSize = kBlockSizes[kNumSizeClasses - 1];
+  // The bytes kept in the free list of each size class at most.
+  static constexpr size_t kDefaultMaxFreeBytes = 4 * 1024 * 1024;
+
+  explicit BufferPool(size_t max_free_bytes = kDefaultMaxFreeBytes);
+  ~BufferPool() = default;
+
+  // Disallow copy.
+  BufferPool(const BufferPool&) noexcept = delete;
+  BufferPool& operator=(const BufferPool&) noexcept = delete;
+
+  // Disallow move.
+  BufferPool(BufferPool&&) noexcept = delete;
+  BufferPool& operator=(BufferPool&&) noexcept = delete;
+
+  // Returns a block of the smallest size class fits `size` bytes, or exactly
+  // `size` bytes from the system allocator if it's larger than
+  // `kMaxBlockSize`.
+  std::vector<char> Allocate(size_t size);
+
+  // Gives back a block allocated for `allocated_size` bytes, i.e. the size
+  // passed to `Allocate()`, which accounts it to the same size class. The
+  // block may have grown since, it's filed under the largest size class its
+  // capacity could serve then.
+  void Deallocate(std::vector<char>&& block, size_t allocated_size);
+
+  // Could be called in any thread.
+  [[nodiscard]] std::vector<BufferPoolStats> GetStats() const;
+
+  [[nodiscard]] size_t free_blocks(size_t block_size) const;
+  [[nodiscard]] int64_t outstanding_blocks(size_t block_size) const;
+
+ private:
+  struct SizeClass {
+    size_t block_size{0};
+    size_t max_free_blocks{0};
+    std::vector<std::vector<char>> free_blocks;  // Assert access in owner.
+
+    std::atomic<size_t> free_blocks_count{0};
+    std::atomic<int64_t> outstanding_blocks{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+  };
+
+  [[nodiscard]] bool IsInOwnerThread() const;
+
+  // Returns kNumSizeClasses if it doesn't fit any class.
+  [[nodiscard]] static size_t SizeClassOf(size_t size);
+
+  const int owner_thread_id_;
+  std::array<SizeClass, kNumSizeClasses> size_classes_;
+};
+
+}  // namespace net
+}  // namespace jinduo
@@ -26,6 +26,7 @@
 #include "one/jinduo/net/internal/channel.h"
 
 #include <poll.h>
+#include <sys/epoll.h>
 
 #include <atomic>
 #include <memory>
@@ -41,6 +42,7 @@ const uint32_t Channel::kNoneEvent = 0;
 const uint32_t Channel::kReadEvent =
     POLLIN | POLLPRI;  // NOLINT(hicpp-signed-bitwise)
 const uint32_t Channel::kWriteEvent = POLLOUT;
+const uint32_t Channel::kEdgeTriggered = EPOLLET;
 
 Channel::Channel(EventLoop* loop, int fd) : loop_(loop), fd_(fd) {}
 
@@ -53,6 +55,28 @@ Channel::~Channel() {
   }
 }
 
+uint32_t Channel::events() const {
+  if (events_ == kNoneEvent) {
+    return kNoneEvent;
+  }
+  uint32_t events = events_;
+  if (edge_triggered_) {
+    events |= kWriteEvent | kEdgeTriggered;
+  }
+  return events;
+}
+
+bool Channel::SetEdgeTriggered(bool on) {
+  if (on && !loop_->SupportsEdgeTriggered()) {
+    return false;
+  }
+  edge_triggered_ = on;
+  if (added_to_loop_.load(std::memory_order_acquire)) {
+    Update();
+  }
+  return true;
+}
+
 void Channel::Tie(const std::shared_ptr<void>& obj) {
   tie_ = std::weak_ptr<void>(obj);
   tied_ = true;
@@ -100,7 +124,9 @@ void Channel::HandleEventWithGuard(absl::Time receiveTime) {
       read_callback_(receiveTime);
     }
   }
-  if ((revents_ & POLLOUT) != 0) {  // NOLINT(hicpp-signed-bitwise)
+  // The write event is always polled in edge-triggered mode.
+  if ((revents_ & POLLOUT) != 0 &&  // NOLINT(hicpp-signed-bitwise)
+      IsWritingEnabled()) {
     if (write_callback_) {
       write_callback_();
     }
@@ -117,6 +143,12 @@ void Channel::RemoveFromOwnerEventLoop() {
 }
 
 void Channel::Update() {
+  const uint32_t events = this->events();
+  if (added_to_loop_.load(std::memory_order_acquire) &&
+      events == registered_events_) {
+    return;
+  }
+  registered_events_ = events;
   added_to_loop_.store(true, std::memory_order_release);
   loop_->UpdateChannel(this);
 }
@@ -147,6 +179,9 @@ std::string EventsToStringInternal(int fd, uint32_t ev) {
   if ((ev & POLLNVAL) != 0) {  // NOLINT(hicpp-signed-bitwise)
     oss << "NVAL ";
   }
+  if ((ev & EPOLLET) != 0) {  // NOLINT(hicpp-signed-bitwise)
+    oss << "ET ";
+  }
 
   return oss.str();
 }
@@ -34,6 +34,7 @@
 #include <utility>
 
 #include "absl/time/time.h"
+#include "one/base/small_function.h"
 
 namespace jinduo {
 namespace net {
@@ -48,10 +49,11 @@ class Channel {
   static const uint32_t kNoneEvent;
   static const uint32_t kReadEvent;
   static const uint32_t kWriteEvent;
+  static const uint32_t kEdgeTriggered;
 
  public:
-  using EventCallback = std::function<void()>;
-  using ReadEventCallback = std::function<void(absl::Time)>;
+  using EventCallback = hcoona::SmallFunction<void()>;
+  using ReadEventCallback = hcoona::SmallFunction<void(absl::Time)>;
 
   Channel(EventLoop* loop, int fd);
   ~Channel();
@@ -85,8 +87,12 @@ class Channel {
 
   [[nodiscard]] int fd() const { return fd_; }
 
-  // Requested events for poller. See poll(2) manpage.
-  [[nodiscard]] uint32_t events() const { return events_; }
+  // Requested events for poller. See poll(2) & epoll_ctl(2) manpage.
+  //
+  // In edge-triggered mode, the write event is always requested along with
+  // the read event, enabling/disabling writing only flips the interest kept
+  // by the channel & doesn't touch the poller.
+  [[nodiscard]] uint32_t events() const;
 
   // Returned events from poller. See poll(2) manpage.
   [[nodiscard]] uint32_t revents() const { return revents_; }
@@ -125,6 +131,12 @@ class Channel {
     return (events_ & kWriteEvent) != 0U;
   }
 
+  // Switches to edge-triggered mode, the callbacks must drain the fd until
+  // EAGAIN. Returns false if the poller doesn't support it, the channel keeps
+  // level-triggered then.
+  bool SetEdgeTriggered(bool on);
+  [[nodiscard]] bool IsEdgeTriggered() const { return edge_triggered_; }
+
   //
   // For poller
   //
@@ -159,6 +171,9 @@ class Channel {
   int fd_;
   uint32_t events_{0};
   uint32_t revents_{0};  // it's the received event types of epoll or poll
+  bool edge_triggered_{false};
+  // What the poller has, to skip updating it with the same events.
+  uint32_t registered_events_{0};
   int index_{-1};        // used by Poller.
   std::atomic<bool> log_hup_enabled_{true};
 
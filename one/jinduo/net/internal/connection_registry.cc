@@ -0,0 +1,67 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/internal/connection_registry.h"
+
+#include <cassert>
+#include <utility>
+
+#include "one/jinduo/net/event_loop.h"
+#include "one/jinduo/net/tcp_connection.h"
+
+namespace jinduo {
+namespace net {
+
+ConnectionRegistry::ConnectionRegistry(EventLoop* loop, uint32_t index)
+    : loop_(loop), index_(index) {
+  assert(index < kMaxRegistries);
+}
+
+void ConnectionRegistry::Add(std::shared_ptr<TcpConnection> conn) {
+  loop_->AssertInLoopThread();
+  ConnectionId id = conn->id();
+  assert(IndexOf(id) == index_);
+  bool inserted = connections_.try_emplace(id, std::move(conn)).second;
+  (void)inserted;
+  assert(inserted);
+}
+
+bool ConnectionRegistry::Remove(ConnectionId id) {
+  loop_->AssertInLoopThread();
+  return connections_.erase(id) == 1;
+}
+
+std::shared_ptr<TcpConnection> ConnectionRegistry::Find(
+    ConnectionId id) const {
+  loop_->AssertInLoopThread();
+  auto it = connections_.find(id);
+  return it != connections_.end() ? it->second : nullptr;
+}
+
+std::vector<std::shared_ptr<TcpConnection>> ConnectionRegistry::TakeAll() {
+  loop_->AssertInLoopThread();
+  std::vector<std::shared_ptr<TcpConnection>> conns;
+  conns.reserve(connections_.size());
+  for (auto& item : connections_) {
+    conns.push_back(std::move(item.second));
+  }
+  connections_.clear();
+  return conns;
+}
+
+}  // namespace net
+}  // namespace jinduo
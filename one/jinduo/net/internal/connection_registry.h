@@ -0,0 +1,93 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is an internal header file, you should not include this.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "one/jinduo/net/callbacks.h"
+
+namespace jinduo {
+namespace net {
+
+class EventLoop;
+
+// The connections of a TcpServer served by an EventLoop, indexed by their ids.
+//
+// The low bits of an id are the index of its registry, the others a sequence,
+// so the registry & loop of a connection are found from its id alone.
+//
+// Not thread safe, access it in the loop thread, except `NextId`.
+class ConnectionRegistry {
+ public:
+  static constexpr int kIndexBits = 12;
+  static constexpr uint32_t kMaxRegistries = 1U << kIndexBits;
+
+  ConnectionRegistry(EventLoop* loop, uint32_t index);
+  ~ConnectionRegistry() = default;
+
+  // Disallow copy.
+  ConnectionRegistry(const ConnectionRegistry&) noexcept = delete;
+  ConnectionRegistry& operator=(const ConnectionRegistry&) noexcept = delete;
+
+  // Disallow move.
+  ConnectionRegistry(ConnectionRegistry&&) noexcept = delete;
+  ConnectionRegistry& operator=(ConnectionRegistry&&) noexcept = delete;
+
+  static uint32_t IndexOf(ConnectionId id) {
+    return static_cast<uint32_t>(id & (kMaxRegistries - 1));
+  }
+
+  [[nodiscard]] EventLoop* loop() const { return loop_; }
+
+  [[nodiscard]] size_t size() const { return connections_.size(); }
+
+  // Thread safe.
+  ConnectionId NextId() {
+    return (next_sequence_.fetch_add(1, std::memory_order_relaxed)
+            << kIndexBits) |
+           index_;
+  }
+
+  void Add(std::shared_ptr<TcpConnection> conn);
+
+  // Returns false if it's not registered.
+  bool Remove(ConnectionId id);
+
+  // nullptr if it's not registered.
+  [[nodiscard]] std::shared_ptr<TcpConnection> Find(ConnectionId id) const;
+
+  // Removes all the connections.
+  std::vector<std::shared_ptr<TcpConnection>> TakeAll();
+
+ private:
+  EventLoop* loop_;
+  const uint32_t index_;
+  std::atomic<uint64_t> next_sequence_{1};
+  absl::flat_hash_map<ConnectionId, std::shared_ptr<TcpConnection>>
+      connections_;
+};
+
+}  // namespace net
+}  // namespace jinduo
@@ -0,0 +1,85 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/internal/connection_registry.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+#include <set>
+
+#include "gtest/gtest.h"
+#include "one/jinduo/net/event_loop.h"
+#include "one/jinduo/net/inet_address.h"
+#include "one/jinduo/net/tcp_connection.h"
+
+using jinduo::net::ConnectionId;
+using jinduo::net::ConnectionRegistry;
+using jinduo::net::EventLoop;
+using jinduo::net::InetAddress;
+using jinduo::net::TcpConnection;
+
+namespace {
+
+std::shared_ptr<TcpConnection> NewConnection(EventLoop* loop,
+                                             ConnectionId id) {
+  int fds[2];
+  EXPECT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  ::close(fds[1]);
+  auto conn = std::make_shared<TcpConnection>(loop, "conn", fds[0],
+                                              InetAddress(), InetAddress(), id);
+  conn->setConnectionCallback(jinduo::net::defaultConnectionCallback);
+  conn->connectEstablished();
+  return conn;
+}
+
+}  // namespace
+
+TEST(ConnectionRegistry, NextId) {
+  EventLoop loop;
+  ConnectionRegistry registry(&loop, 5);
+  std::set<ConnectionId> ids;
+  for (int i = 0; i < 100; ++i) {
+    ConnectionId id = registry.NextId();
+    EXPECT_EQ(5U, ConnectionRegistry::IndexOf(id));
+    EXPECT_TRUE(ids.insert(id).second);
+  }
+}
+
+TEST(ConnectionRegistry, AddFindRemove) {
+  EventLoop loop;
+  ConnectionRegistry registry(&loop, 1);
+  std::shared_ptr<TcpConnection> a = NewConnection(&loop, registry.NextId());
+  std::shared_ptr<TcpConnection> b = NewConnection(&loop, registry.NextId());
+  registry.Add(a);
+  registry.Add(b);
+  EXPECT_EQ(2U, registry.size());
+  EXPECT_EQ(a, registry.Find(a->id()));
+  EXPECT_EQ(b, registry.Find(b->id()));
+
+  EXPECT_TRUE(registry.Remove(a->id()));
+  EXPECT_FALSE(registry.Remove(a->id()));
+  EXPECT_EQ(nullptr, registry.Find(a->id()));
+  a->connectDestroyed();
+
+  auto all = registry.TakeAll();
+  ASSERT_EQ(1U, all.size());
+  EXPECT_EQ(b, all[0]);
+  EXPECT_EQ(0U, registry.size());
+  b->connectDestroyed();
+}
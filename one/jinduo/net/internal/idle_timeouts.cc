@@ -0,0 +1,135 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/internal/idle_timeouts.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "one/jinduo/net/event_loop.h"
+#include "one/jinduo/net/tcp_connection.h"
+
+namespace jinduo {
+namespace net {
+
+constexpr int IdleTimeoutEntry::kNumTimeouts;
+
+IdleTimeouts::IdleTimeouts(EventLoop* loop, absl::Duration read_idle,
+                           absl::Duration write_idle, absl::Duration lifetime,
+                           ConnectionTimeoutCallback callback)
+    : loop_(loop),
+      timeouts_{read_idle, write_idle, lifetime},
+      callback_(std::move(callback)) {}
+
+void IdleTimeouts::Start() {
+  // A connection expires at most an interval late.
+  static constexpr absl::Duration kMinInterval = absl::Milliseconds(10);
+  static constexpr absl::Duration kMaxInterval = absl::Seconds(1);
+  absl::Duration interval = kMaxInterval;
+  for (absl::Duration timeout : timeouts_) {
+    if (timeout > absl::ZeroDuration()) {
+      interval = std::min(interval, timeout / 8);
+    }
+  }
+  interval = std::max(interval, kMinInterval);
+
+  timer_ = loop_->RunEvery(interval, [weak_this = weak_from_this()] {
+    std::shared_ptr<IdleTimeouts> shared_this = weak_this.lock();
+    if (shared_this) {
+      shared_this->Check(absl::Now());
+    }
+  });
+}
+
+void IdleTimeouts::Stop() { loop_->CancelTimer(timer_); }
+
+void IdleTimeouts::Add(IdleTimeoutEntry* entry, absl::Time now) {
+  loop_->AssertInLoopThread();
+  for (int i = 0; i < IdleTimeoutEntry::kNumTimeouts; ++i) {
+    if (timeouts_[i] > absl::ZeroDuration() && !entry->linked[i]) {
+      entry->last[i] = now;
+      Link(entry, i);
+    }
+  }
+}
+
+void IdleTimeouts::Remove(IdleTimeoutEntry* entry) {
+  loop_->AssertInLoopThread();
+  for (int i = 0; i < IdleTimeoutEntry::kNumTimeouts; ++i) {
+    if (entry->linked[i]) {
+      Unlink(entry, i);
+    }
+  }
+}
+
+void IdleTimeouts::Check(absl::Time now) {
+  loop_->AssertInLoopThread();
+  std::vector<std::pair<std::shared_ptr<TcpConnection>, ConnectionTimeout>>
+      expired;
+  for (int i = 0; i < IdleTimeoutEntry::kNumTimeouts; ++i) {
+    const auto timeout = static_cast<ConnectionTimeout>(i);
+    // Only the fronts can be expired, the ones touched later are behind.
+    IdleTimeoutEntry* entry = head_[i];
+    while (entry != nullptr && entry->last[i] + timeouts_[i] <= now) {
+      IdleTimeoutEntry* next = entry->next[i];
+      Unlink(entry, i);
+      if (timeout != ConnectionTimeout::kLifetime) {
+        entry->last[i] = now;
+        Link(entry, i);
+      }
+      expired.emplace_back(entry->conn->shared_from_this(), timeout);
+      // The re-linked ones at the back aren't expired, the walk stops there.
+      entry = next;
+    }
+  }
+  // Out of the walk, the callbacks may close the connections.
+  for (const auto& [conn, timeout] : expired) {
+    callback_(conn, timeout);
+  }
+}
+
+void IdleTimeouts::Link(IdleTimeoutEntry* entry, int index) {
+  entry->prev[index] = tail_[index];
+  entry->next[index] = nullptr;
+  if (tail_[index] != nullptr) {
+    tail_[index]->next[index] = entry;
+  } else {
+    head_[index] = entry;
+  }
+  tail_[index] = entry;
+  entry->linked[index] = true;
+}
+
+void IdleTimeouts::Unlink(IdleTimeoutEntry* entry, int index) {
+  if (entry->prev[index] != nullptr) {
+    entry->prev[index]->next[index] = entry->next[index];
+  } else {
+    head_[index] = entry->next[index];
+  }
+  if (entry->next[index] != nullptr) {
+    entry->next[index]->prev[index] = entry->prev[index];
+  } else {
+    tail_[index] = entry->prev[index];
+  }
+  entry->prev[index] = nullptr;
+  entry->next[index] = nullptr;
+  entry->linked[index] = false;
+}
+
+}  // namespace net
+}  // namespace jinduo
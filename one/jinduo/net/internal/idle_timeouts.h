@@ -0,0 +1,119 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is an internal header file, you should not include this.
+
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include "absl/time/time.h"
+#include "one/jinduo/net/callbacks.h"
+#include "one/jinduo/net/timer_id.h"
+
+namespace jinduo {
+namespace net {
+
+class EventLoop;
+class IdleTimeouts;
+
+// Embedded in a TcpConnection tracked by IdleTimeouts.
+struct IdleTimeoutEntry {
+  static constexpr int kNumTimeouts = 3;
+
+  TcpConnection* conn{nullptr};
+  std::shared_ptr<IdleTimeouts> owner;
+  // Indexed by ConnectionTimeout.
+  std::array<IdleTimeoutEntry*, kNumTimeouts> prev{};
+  std::array<IdleTimeoutEntry*, kNumTimeouts> next{};
+  std::array<bool, kNumTimeouts> linked{};
+  std::array<absl::Time, kNumTimeouts> last{};
+};
+
+// The read-idle, write-idle & lifetime timeouts of the connections of a
+// TcpServer in an EventLoop.
+//
+// A connection is in a list per timeout, ordered by its last activity, which
+// is moved to the back on activity. Since all the connections share the same
+// timeout, only the fronts may be expired, they're checked by a periodic timer
+// of the loop. So there is no timer per connection, and touching is O(1).
+//
+// Not thread safe, access it in the loop thread, except Start & Stop.
+class IdleTimeouts : public std::enable_shared_from_this<IdleTimeouts> {
+ public:
+  // A zero duration disables the timeout.
+  IdleTimeouts(EventLoop* loop, absl::Duration read_idle,
+               absl::Duration write_idle, absl::Duration lifetime,
+               ConnectionTimeoutCallback callback);
+  ~IdleTimeouts() = default;
+
+  // Disallow copy.
+  IdleTimeouts(const IdleTimeouts&) noexcept = delete;
+  IdleTimeouts& operator=(const IdleTimeouts&) noexcept = delete;
+
+  // Disallow move.
+  IdleTimeouts(IdleTimeouts&&) noexcept = delete;
+  IdleTimeouts& operator=(IdleTimeouts&&) noexcept = delete;
+
+  [[nodiscard]] bool enabled(ConnectionTimeout timeout) const {
+    return timeouts_[Index(timeout)] > absl::ZeroDuration();
+  }
+
+  // Starts & stops the periodic check, thread safe.
+  void Start();
+  void Stop();
+
+  void Add(IdleTimeoutEntry* entry, absl::Time now);
+  void Remove(IdleTimeoutEntry* entry);
+
+  // Records an activity of the connection.
+  void Touch(IdleTimeoutEntry* entry, ConnectionTimeout timeout,
+             absl::Time now) {
+    const int index = Index(timeout);
+    if (entry->linked[index]) {
+      entry->last[index] = now;
+      if (entry->next[index] != nullptr) {
+        Unlink(entry, index);
+        Link(entry, index);
+      }
+    }
+  }
+
+  // Runs the callback for the expired connections, the idle ones are tracked
+  // again as if they were active now, so they expire again unless closed.
+  void Check(absl::Time now);
+
+ private:
+  static int Index(ConnectionTimeout timeout) {
+    return static_cast<int>(timeout);
+  }
+
+  void Link(IdleTimeoutEntry* entry, int index);
+  void Unlink(IdleTimeoutEntry* entry, int index);
+
+  EventLoop* loop_;
+  const std::array<absl::Duration, IdleTimeoutEntry::kNumTimeouts> timeouts_;
+  const ConnectionTimeoutCallback callback_;
+  TimerId timer_;
+
+  std::array<IdleTimeoutEntry*, IdleTimeoutEntry::kNumTimeouts> head_{};
+  std::array<IdleTimeoutEntry*, IdleTimeoutEntry::kNumTimeouts> tail_{};
+};
+
+}  // namespace net
+}  // namespace jinduo
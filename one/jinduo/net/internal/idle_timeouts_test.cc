@@ -0,0 +1,199 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/internal/idle_timeouts.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "one/jinduo/net/event_loop.h"
+#include "one/jinduo/net/inet_address.h"
+#include "one/jinduo/net/tcp_connection.h"
+
+using jinduo::net::ConnectionTimeout;
+using jinduo::net::EventLoop;
+using jinduo::net::IdleTimeoutEntry;
+using jinduo::net::IdleTimeouts;
+using jinduo::net::InetAddress;
+using jinduo::net::TcpConnection;
+
+namespace {
+
+using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+using Expired = std::pair<TcpConnection*, ConnectionTimeout>;
+
+// Connections to be tracked, the timeouts are checked with explicit times
+// instead of the loop timer.
+class IdleTimeoutsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    timeouts_ = std::make_shared<IdleTimeouts>(
+        &loop_, absl::Seconds(10), absl::Seconds(20), absl::Seconds(60),
+        [this](const TcpConnectionPtr& conn, ConnectionTimeout timeout) {
+          expired_.emplace_back(conn.get(), timeout);
+          if (on_expired_) {
+            on_expired_(conn.get());
+          }
+        });
+    for (int i = 0; i < 3; ++i) {
+      int fds[2];
+      ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds));
+      peers_.push_back(fds[1]);
+      auto conn = std::make_shared<TcpConnection>(
+          &loop_, "conn", fds[0], InetAddress(), InetAddress());
+      conn->setConnectionCallback(jinduo::net::defaultConnectionCallback);
+      conn->connectEstablished();
+      entries_[i].conn = conn.get();
+      conns_.push_back(std::move(conn));
+    }
+  }
+
+  void TearDown() override {
+    for (auto& entry : entries_) {
+      timeouts_->Remove(&entry);
+    }
+    for (auto& conn : conns_) {
+      conn->connectDestroyed();
+    }
+    for (int peer : peers_) {
+      ::close(peer);
+    }
+  }
+
+  // Takes the expired connections since the last call.
+  std::vector<Expired> TakeExpired() { return std::exchange(expired_, {}); }
+
+  Expired Of(int i, ConnectionTimeout timeout) {
+    return {conns_[i].get(), timeout};
+  }
+
+  const absl::Time t0_ = absl::FromUnixSeconds(1000);
+  EventLoop loop_;
+  std::shared_ptr<IdleTimeouts> timeouts_;
+  std::vector<TcpConnectionPtr> conns_;
+  std::vector<int> peers_;
+  IdleTimeoutEntry entries_[3];
+  std::vector<Expired> expired_;
+  std::function<void(TcpConnection*)> on_expired_;
+};
+
+}  // namespace
+
+TEST_F(IdleTimeoutsTest, AddAndCheck) {
+  timeouts_->Add(&entries_[0], t0_);
+  timeouts_->Add(&entries_[1], t0_ + absl::Seconds(5));
+  timeouts_->Check(t0_ + absl::Seconds(9));
+  EXPECT_TRUE(TakeExpired().empty());
+
+  timeouts_->Check(t0_ + absl::Seconds(10));
+  EXPECT_EQ(std::vector<Expired>{Of(0, ConnectionTimeout::kReadIdle)},
+            TakeExpired());
+  // Added 5s later, & the untracked 2 never expires.
+  timeouts_->Check(t0_ + absl::Seconds(15));
+  EXPECT_EQ(std::vector<Expired>{Of(1, ConnectionTimeout::kReadIdle)},
+            TakeExpired());
+}
+
+TEST_F(IdleTimeoutsTest, TouchMovesToTheBack) {
+  for (auto& entry : entries_) {
+    timeouts_->Add(&entry, t0_);
+  }
+  timeouts_->Touch(&entries_[0], ConnectionTimeout::kReadIdle,
+                   t0_ + absl::Seconds(5));
+  timeouts_->Touch(&entries_[1], ConnectionTimeout::kWriteIdle,
+                   t0_ + absl::Seconds(5));
+
+  // The read of 0 is behind 1 & 2 now, the write of 1 is behind 0 & 2.
+  timeouts_->Check(t0_ + absl::Seconds(10));
+  EXPECT_EQ((std::vector<Expired>{Of(1, ConnectionTimeout::kReadIdle),
+                                  Of(2, ConnectionTimeout::kReadIdle)}),
+            TakeExpired());
+  timeouts_->Check(t0_ + absl::Seconds(15));
+  EXPECT_EQ(std::vector<Expired>{Of(0, ConnectionTimeout::kReadIdle)},
+            TakeExpired());
+  timeouts_->Check(t0_ + absl::Seconds(20));
+  // Re-linked at 10s by the check, the reads of 1 & 2 expire again too.
+  EXPECT_EQ((std::vector<Expired>{Of(1, ConnectionTimeout::kReadIdle),
+                                  Of(2, ConnectionTimeout::kReadIdle),
+                                  Of(0, ConnectionTimeout::kWriteIdle),
+                                  Of(2, ConnectionTimeout::kWriteIdle)}),
+            TakeExpired());
+}
+
+TEST_F(IdleTimeoutsTest, Remove) {
+  timeouts_->Add(&entries_[0], t0_);
+  timeouts_->Add(&entries_[1], t0_);
+  timeouts_->Remove(&entries_[0]);
+  for (bool linked : entries_[0].linked) {
+    EXPECT_FALSE(linked);
+  }
+  // Touching a removed one is a no-op.
+  timeouts_->Touch(&entries_[0], ConnectionTimeout::kReadIdle,
+                   t0_ + absl::Seconds(5));
+  timeouts_->Check(t0_ + absl::Seconds(60));
+  const std::vector<Expired> expired_ones = TakeExpired();
+  EXPECT_EQ(3U, expired_ones.size());
+  for (const Expired& expired : expired_ones) {
+    EXPECT_EQ(conns_[1].get(), expired.first);
+  }
+}
+
+TEST_F(IdleTimeoutsTest, IdleRelinkedButLifetimeNot) {
+  timeouts_->Add(&entries_[0], t0_);
+  timeouts_->Check(t0_ + absl::Seconds(10));
+  EXPECT_EQ(std::vector<Expired>{Of(0, ConnectionTimeout::kReadIdle)},
+            TakeExpired());
+  EXPECT_TRUE(entries_[0].linked[0]);
+  EXPECT_EQ(t0_ + absl::Seconds(10), entries_[0].last[0]);
+
+  // Expires again a timeout later, unless closed.
+  timeouts_->Check(t0_ + absl::Seconds(19));
+  EXPECT_TRUE(TakeExpired().empty());
+  timeouts_->Check(t0_ + absl::Seconds(60));
+  EXPECT_EQ((std::vector<Expired>{Of(0, ConnectionTimeout::kReadIdle),
+                                  Of(0, ConnectionTimeout::kWriteIdle),
+                                  Of(0, ConnectionTimeout::kLifetime)}),
+            TakeExpired());
+  EXPECT_TRUE(entries_[0].linked[0]);
+  EXPECT_TRUE(entries_[0].linked[1]);
+  EXPECT_FALSE(entries_[0].linked[2]);
+}
+
+TEST_F(IdleTimeoutsTest, CallbackRemoves) {
+  timeouts_->Add(&entries_[0], t0_);
+  timeouts_->Add(&entries_[1], t0_);
+  // Closing a connection removes its entry, as TcpConnection does.
+  on_expired_ = [this](TcpConnection* conn) {
+    for (auto& entry : entries_) {
+      if (entry.conn == conn) {
+        timeouts_->Remove(&entry);
+      }
+    }
+  };
+  timeouts_->Check(t0_ + absl::Seconds(10));
+  EXPECT_EQ((std::vector<Expired>{Of(0, ConnectionTimeout::kReadIdle),
+                                  Of(1, ConnectionTimeout::kReadIdle)}),
+            TakeExpired());
+  timeouts_->Check(t0_ + absl::Seconds(100));
+  EXPECT_TRUE(TakeExpired().empty());
+}
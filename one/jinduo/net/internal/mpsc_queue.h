@@ -0,0 +1,89 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is an internal header file, you should not include this.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace jinduo {
+namespace net {
+
+// An intrusive lock-free multi-producer single-consumer queue.
+//
+// `Node` must have a `Node* mpsc_next` member. Producers link nodes onto an
+// atomic stack with a single CAS, the consumer takes all the nodes at once
+// with an exchange and reverses them into FIFO order. So a round of consuming
+// never sees the nodes pushed during it.
+//
+// The queue never owns the nodes.
+template <typename Node>
+class MpscQueue {
+ public:
+  MpscQueue() = default;
+  ~MpscQueue() = default;
+
+  // Disallow copy.
+  MpscQueue(const MpscQueue&) noexcept = delete;
+  MpscQueue& operator=(const MpscQueue&) noexcept = delete;
+
+  // Disallow move.
+  MpscQueue(MpscQueue&&) noexcept = delete;
+  MpscQueue& operator=(MpscQueue&&) noexcept = delete;
+
+  // Returns true if the queue was empty before pushing. Safe to call from
+  // any thread.
+  bool Push(Node* node) { return PushChain(node, node); }
+
+  // Pushes a chain of nodes linked with `mpsc_next` from the newest `first`
+  // to the oldest `last`, in a single CAS. Safe to call from any thread.
+  bool PushChain(Node* first, Node* last) {
+    Node* head = head_.load(std::memory_order_relaxed);
+    do {
+      last->mpsc_next = head;
+    } while (!head_.compare_exchange_weak(head, first,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+    return head == nullptr;
+  }
+
+  // Takes all the nodes in FIFO order, linked with `mpsc_next`. Must be
+  // called in the consumer thread.
+  Node* PopAll() {
+    Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+    Node* reversed = nullptr;
+    while (node != nullptr) {
+      Node* next = node->mpsc_next;
+      node->mpsc_next = reversed;
+      reversed = node;
+      node = next;
+    }
+    return reversed;
+  }
+
+  [[nodiscard]] bool empty() const {
+    return head_.load(std::memory_order_acquire) == nullptr;
+  }
+
+ private:
+  std::atomic<Node*> head_{nullptr};
+};
+
+}  // namespace net
+}  // namespace jinduo
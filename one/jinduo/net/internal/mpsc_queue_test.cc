@@ -0,0 +1,101 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/internal/mpsc_queue.h"
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using jinduo::net::MpscQueue;
+
+namespace {
+
+struct Node {
+  int producer{0};
+  int value{0};
+  Node* mpsc_next{nullptr};
+};
+
+}  // namespace
+
+TEST(MpscQueue, PushPopAll) {
+  MpscQueue<Node> queue;
+  Node nodes[3] = {{0, 0}, {0, 1}, {0, 2}};
+  EXPECT_TRUE(queue.empty());
+  EXPECT_TRUE(queue.Push(&nodes[0]));
+  EXPECT_FALSE(queue.Push(&nodes[1]));
+  EXPECT_FALSE(queue.Push(&nodes[2]));
+
+  int expected = 0;
+  for (Node* node = queue.PopAll(); node != nullptr; node = node->mpsc_next) {
+    EXPECT_EQ(node->value, expected++);
+  }
+  EXPECT_EQ(expected, 3);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.PopAll(), nullptr);
+}
+
+TEST(MpscQueue, PushChain) {
+  MpscQueue<Node> queue;
+  Node nodes[4] = {{0, 0}, {0, 1}, {0, 2}, {0, 3}};
+  queue.Push(&nodes[0]);
+  // Linked from the newest one to the oldest one.
+  nodes[3].mpsc_next = &nodes[2];
+  nodes[2].mpsc_next = &nodes[1];
+  EXPECT_FALSE(queue.PushChain(&nodes[3], &nodes[1]));
+
+  int expected = 0;
+  for (Node* node = queue.PopAll(); node != nullptr; node = node->mpsc_next) {
+    EXPECT_EQ(node->value, expected++);
+  }
+  EXPECT_EQ(expected, 4);
+}
+
+TEST(MpscQueue, MultipleProducers) {
+  static constexpr int kProducers = 4;
+  static constexpr int kNodesPerProducer = 100000;
+  MpscQueue<Node> queue;
+  std::vector<std::vector<Node>> nodes(kProducers,
+                                       std::vector<Node>(kNodesPerProducer));
+  std::vector<std::thread> producers;
+  for (int i = 0; i < kProducers; ++i) {
+    producers.emplace_back([&queue, &nodes, i] {
+      for (int j = 0; j < kNodesPerProducer; ++j) {
+        nodes[i][j].producer = i;
+        nodes[i][j].value = j;
+        queue.Push(&nodes[i][j]);
+      }
+    });
+  }
+
+  // Nodes of each producer come out in order.
+  std::vector<int> next_values(kProducers, 0);
+  int popped = 0;
+  while (popped < kProducers * kNodesPerProducer) {
+    for (Node* node = queue.PopAll(); node != nullptr;
+         node = node->mpsc_next) {
+      ASSERT_EQ(node->value, next_values[node->producer]++);
+      ++popped;
+    }
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  EXPECT_TRUE(queue.empty());
+}
@@ -71,6 +71,9 @@ class Poller {
 
   virtual bool HasChannel(Channel* channel) const;
 
+  /// Whether `Channel` could be edge-triggered.
+  virtual bool SupportsEdgeTriggered() const { return false; }
+
   void AssertInLoopThread() const { owner_loop_->AssertInLoopThread(); }
 
  protected:
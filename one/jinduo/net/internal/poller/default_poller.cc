@@ -22,8 +22,10 @@
 
 #include <cstdlib>
 
+#include "glog/logging.h"
 #include "one/jinduo/net/internal/poller.h"
 #include "one/jinduo/net/internal/poller/epoll_poller.h"
+#include "one/jinduo/net/internal/poller/io_uring_poller.h"
 #include "one/jinduo/net/internal/poller/poll_poller.h"
 
 namespace jinduo {
@@ -34,6 +36,12 @@ Poller* Poller::CreateDefaultPoller(EventLoop* loop) {
   if (::getenv("JINDUO_USE_POLL") != nullptr) {
     return new PollPoller(loop);
   }
+  if (::getenv("JINDUO_USE_IO_URING") != nullptr) {
+    if (IoUringPoller::IsSupported()) {
+      return new IoUringPoller(loop);
+    }
+    LOG(WARNING) << "io_uring is not supported, falling back to epoll.";
+  }
   return new EPollPoller(loop);
 }
 
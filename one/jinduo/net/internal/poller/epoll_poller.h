@@ -53,6 +53,7 @@ class EPollPoller : public Poller {
 
   void UpdateChannel(Channel* channel) override;
   void RemoveChannel(Channel* channel) override;
+  bool SupportsEdgeTriggered() const override { return true; }
 
  private:
   void FillActiveChannels(int events_num,
@@ -0,0 +1,369 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/internal/poller/io_uring_poller.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "absl/base/casts.h"
+#include "absl/time/clock.h"
+#include "glog/logging.h"
+#include "one/jinduo/net/internal/channel.h"
+
+namespace jinduo {
+namespace net {
+
+namespace {
+
+constexpr uint32_t kRingEntries = 256;
+
+constexpr int kNew = -1;
+constexpr int kAdded = 1;
+
+// The completions of the requests with it are ignored.
+constexpr uint64_t kIgnoredUserData = ~0ULL;
+
+// IORING_FEAT_RSRC_TAGS comes with Linux 5.13, along with multishot poll.
+constexpr uint32_t kRequiredFeatures =
+    IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+
+int IoUringSetup(uint32_t entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int IoUringEnter(int ring_fd, uint32_t to_submit, uint32_t min_complete,
+                 uint32_t flags, const void* arg, size_t arg_size) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                    min_complete, flags, arg, arg_size));
+}
+
+// The ring indexes are shared with the kernel.
+uint32_t LoadAcquire(const uint32_t* index) {
+  return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+}
+
+void StoreRelease(uint32_t* index, uint32_t value) {
+  __atomic_store_n(index, value, __ATOMIC_RELEASE);
+}
+
+template <typename T>
+T* AtOffset(void* ring, uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+void* MapRing(int ring_fd, size_t size, off_t offset) {
+  void* ring = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+  if (ring == MAP_FAILED) {
+    PLOG(FATAL) << "Failed to mmap io_uring ring, offset=" << offset;
+  }
+  return ring;
+}
+
+uint64_t ToUserData(int fd, uint32_t generation) {
+  return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+
+}  // namespace
+
+// static
+bool IoUringPoller::IsSupported() {
+  static const bool supported = [] {
+    io_uring_params params{};
+    int ring_fd = IoUringSetup(1, &params);
+    if (ring_fd < 0) {
+      PLOG(WARNING) << "io_uring is not available.";
+      return false;
+    }
+    ::close(ring_fd);
+    return (params.features & kRequiredFeatures) == kRequiredFeatures;
+  }();
+  return supported;
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop) : Poller(loop) {
+  io_uring_params params{};
+  ring_fd_ = IoUringSetup(kRingEntries, &params);
+  if (ring_fd_ < 0) {
+    PLOG(FATAL) << "Failed to io_uring_setup().";
+  }
+  if ((params.features & kRequiredFeatures) != kRequiredFeatures) {
+    LOG(FATAL) << "io_uring lacks required features, features="
+               << params.features;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+    sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    sq_ring_ = MapRing(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+    cq_ring_ = sq_ring_;
+    cq_ring_size_ = 0;
+  } else {
+    sq_ring_ = MapRing(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+    cq_ring_ = MapRing(ring_fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = static_cast<io_uring_sqe*>(
+      MapRing(ring_fd_, sqes_size_, IORING_OFF_SQES));
+
+  sq_head_ = AtOffset<uint32_t>(sq_ring_, params.sq_off.head);
+  sq_tail_ = AtOffset<uint32_t>(sq_ring_, params.sq_off.tail);
+  sq_mask_ = *AtOffset<uint32_t>(sq_ring_, params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_array_ = AtOffset<uint32_t>(sq_ring_, params.sq_off.array);
+  cq_head_ = AtOffset<uint32_t>(cq_ring_, params.cq_off.head);
+  cq_tail_ = AtOffset<uint32_t>(cq_ring_, params.cq_off.tail);
+  cq_mask_ = *AtOffset<uint32_t>(cq_ring_, params.cq_off.ring_mask);
+  cqes_ = AtOffset<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+}
+
+IoUringPoller::~IoUringPoller() {
+  ::munmap(sqes_, sqes_size_);
+  if (cq_ring_ != sq_ring_) {
+    ::munmap(cq_ring_, cq_ring_size_);
+  }
+  ::munmap(sq_ring_, sq_ring_size_);
+  ::close(ring_fd_);
+}
+
+absl::Time IoUringPoller::Poll(int timeout_ms,
+                               std::vector<Channel*>* active_channels) {
+  VLOG(2) << "fd total count " << channels_.size();
+
+  for (int fd : rearm_fds_) {
+    Registration* registration = FindRegistration(fd);
+    if (registration != nullptr && registration->channel != nullptr &&
+        !registration->armed && !registration->channel->IsNoneEvent()) {
+      Arm(fd, registration);
+    }
+  }
+  rearm_fds_.clear();
+
+  // Reaps the completions left without a syscall, if nothing to submit.
+  const bool completed = LoadAcquire(cq_tail_) != *cq_head_;
+  int ret = 0;
+  if (sq_pending_ > 0 || !completed) {
+    ret = Enter(sq_pending_, completed || timeout_ms == 0 ? 0 : 1, timeout_ms);
+  }
+
+  absl::Time now(absl::Now());
+  FillActiveChannels(active_channels);
+  if (ret < 0 && ret != -ETIME && ret != -EINTR) {
+    errno = -ret;
+    PLOG(ERROR) << "Failed to io_uring_enter().";
+  }
+  return now;
+}
+
+void IoUringPoller::UpdateChannel(Channel* channel) {
+  Poller::AssertInLoopThread();
+
+  const int fd = channel->fd();
+  VLOG(1) << "fd=" << fd << ", events=" << channel->events()
+          << ", index=" << channel->index();
+
+  if (channel->index() == kNew) {
+    assert(channels_.find(fd) == channels_.end());
+    channels_[fd] = channel;
+    channel->set_index(kAdded);
+    if (absl::implicit_cast<size_t>(fd) >= registrations_.size()) {
+      registrations_.resize(fd + 1);
+    }
+  } else {
+    assert(channels_.find(fd) != channels_.end());
+    assert(channels_[fd] == channel);
+  }
+
+  Registration* registration = &registrations_[fd];
+  registration->channel = channel;
+  if (registration->armed) {
+    Disarm(fd, registration);
+  }
+  if (!channel->IsNoneEvent()) {
+    Arm(fd, registration);
+  }
+}
+
+void IoUringPoller::RemoveChannel(Channel* channel) {
+  Poller::AssertInLoopThread();
+
+  const int fd = channel->fd();
+  VLOG(1) << "fd=" << fd;
+
+  assert(channels_.find(fd) != channels_.end());
+  assert(channels_[fd] == channel);
+  assert(channel->IsNoneEvent());
+  assert(channel->index() == kAdded);
+
+  size_t n = channels_.erase(fd);
+  (void)n;
+  assert(n == 1);
+
+  Registration* registration = &registrations_[fd];
+  if (registration->armed) {
+    Disarm(fd, registration);
+  }
+  registration->channel = nullptr;
+  // Ignores the completions in flight.
+  ++registration->generation;
+  channel->set_index(kNew);
+}
+
+IoUringPoller::Registration* IoUringPoller::FindRegistration(int fd) {
+  if (fd < 0 || absl::implicit_cast<size_t>(fd) >= registrations_.size()) {
+    return nullptr;
+  }
+  return &registrations_[fd];
+}
+
+void IoUringPoller::Arm(int fd, Registration* registration) {
+  const uint32_t events = registration->channel->events();
+  const bool multishot = (events & EPOLLET) != 0;
+
+  io_uring_sqe* sqe = GetSqe();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = events;
+  sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+  sqe->user_data = ToUserData(fd, registration->generation);
+  registration->armed = true;
+}
+
+void IoUringPoller::Disarm(int fd, Registration* registration) {
+  io_uring_sqe* sqe = GetSqe();
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = ToUserData(fd, registration->generation);
+  sqe->user_data = kIgnoredUserData;
+  registration->armed = false;
+  ++registration->generation;
+}
+
+io_uring_sqe* IoUringPoller::GetSqe() {
+  uint32_t tail = *sq_tail_ + sq_pending_;
+  if (tail - LoadAcquire(sq_head_) == sq_entries_) {
+    // Full, submits them without waiting.
+    int ret = Enter(sq_pending_, 0, 0);
+    if (ret < 0) {
+      errno = -ret;
+      PLOG(FATAL) << "Failed to submit to io_uring.";
+    }
+    tail = *sq_tail_ + sq_pending_;
+  }
+  const uint32_t index = tail & sq_mask_;
+  io_uring_sqe* sqe = &sqes_[index];
+  ::memset(sqe, 0, sizeof(*sqe));
+  sq_array_[index] = index;
+  ++sq_pending_;
+  return sqe;
+}
+
+int IoUringPoller::Enter(uint32_t to_submit, uint32_t min_complete,
+                         int timeout_ms) {
+  StoreRelease(sq_tail_, *sq_tail_ + sq_pending_);
+
+  uint32_t flags = IORING_ENTER_GETEVENTS;
+  __kernel_timespec ts{};
+  io_uring_getevents_arg arg{};
+  const void* argp = nullptr;
+  size_t arg_size = 0;
+  if (min_complete > 0 && timeout_ms >= 0) {
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = static_cast<int64_t>(timeout_ms % 1000) * 1000 * 1000;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    flags |= IORING_ENTER_EXT_ARG;
+    argp = &arg;
+    arg_size = sizeof(arg);
+  }
+  int ret = IoUringEnter(ring_fd_, to_submit, min_complete, flags, argp,
+                         arg_size);
+  if (ret < 0) {
+    ret = -errno;
+  }
+  // The kernel consumes the submissions even if waiting fails.
+  sq_pending_ = *sq_tail_ - LoadAcquire(sq_head_);
+  return ret;
+}
+
+void IoUringPoller::FillActiveChannels(
+    std::vector<Channel*>* active_channels) {
+  const size_t first = active_channels->size();
+  uint32_t head = *cq_head_;
+  const uint32_t tail = LoadAcquire(cq_tail_);
+  for (; head != tail; ++head) {
+    const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+    if (cqe.user_data == kIgnoredUserData) {
+      continue;
+    }
+    const int fd = static_cast<int>(cqe.user_data & 0xFFFFFFFFU);
+    const auto generation = static_cast<uint32_t>(cqe.user_data >> 32);
+    Registration* registration = FindRegistration(fd);
+    if (registration == nullptr || registration->channel == nullptr ||
+        registration->generation != generation) {
+      // Completion of a cancelled request.
+      continue;
+    }
+
+    const bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+    if (!more) {
+      registration->armed = false;
+    }
+    // Re-armed even if it failed, the channel would hang otherwise.
+    if (!more) {
+      rearm_fds_.push_back(fd);
+    }
+    uint32_t revents = 0;
+    if (cqe.res < 0) {
+      errno = -cqe.res;
+      PLOG(ERROR) << "io_uring poll failed. fd=" << fd;
+      // Handled by the error callback, which may close it.
+      revents = EPOLLERR;
+    } else {
+      revents = static_cast<uint32_t>(cqe.res);
+    }
+
+    Channel* channel = registration->channel;
+    if (registration->active) {
+      channel->set_revents(channel->revents() | revents);
+    } else {
+      registration->active = true;
+      channel->set_revents(revents);
+      active_channels->push_back(channel);
+    }
+  }
+  StoreRelease(cq_head_, head);
+
+  for (size_t i = first; i < active_channels->size(); ++i) {
+    registrations_[(*active_channels)[i]->fd()].active = false;
+  }
+  if (active_channels->size() > first) {
+    VLOG(2) << active_channels->size() - first << " events happened";
+  }
+}
+
+}  // namespace net
+}  // namespace jinduo
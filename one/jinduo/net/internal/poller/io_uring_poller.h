@@ -0,0 +1,119 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is an internal header file, you should not include this.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "one/jinduo/net/internal/poller.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace jinduo {
+namespace net {
+
+// IO Multiplexing with io_uring(7).
+//
+// Every channel is polled with an IORING_OP_POLL_ADD request. The requests
+// for the updated channels are queued in the submission ring & submitted
+// along with waiting for the completions, in a single io_uring_enter(2) per
+// iteration, so updating a channel costs no syscall.
+//
+// A level-triggered channel is polled one-shot & re-armed after its event is
+// handled, which sees the fd readiness again like epoll does. An
+// edge-triggered channel is polled multishot & never re-armed.
+//
+// It's built on the raw syscalls, requires Linux 5.13 or later.
+class IoUringPoller : public Poller {
+ public:
+  explicit IoUringPoller(EventLoop* loop);
+  ~IoUringPoller() override;
+
+  // Disallow copy.
+  IoUringPoller(const IoUringPoller&) noexcept = delete;
+  IoUringPoller& operator=(const IoUringPoller&) noexcept = delete;
+
+  // Disallow move.
+  IoUringPoller(IoUringPoller&&) noexcept = delete;
+  IoUringPoller& operator=(IoUringPoller&&) noexcept = delete;
+
+  // Whether the kernel provides the io_uring features it needs.
+  static bool IsSupported();
+
+  absl::Time Poll(int timeout_ms,
+                  std::vector<Channel*>* active_channels) override;
+
+  void UpdateChannel(Channel* channel) override;
+  void RemoveChannel(Channel* channel) override;
+  bool SupportsEdgeTriggered() const override { return true; }
+
+ private:
+  // The poll request of a fd.
+  struct Registration {
+    Channel* channel{nullptr};
+    // Tells the completions of the requests cancelled from the current one.
+    uint32_t generation{0};
+    bool armed{false};
+    // Handled in this iteration, the revents of its completions are merged.
+    bool active{false};
+  };
+
+  Registration* FindRegistration(int fd);
+  void Arm(int fd, Registration* registration);
+  void Disarm(int fd, Registration* registration);
+  io_uring_sqe* GetSqe();
+  // Returns the number of completions, or -errno.
+  int Enter(uint32_t to_submit, uint32_t min_complete, int timeout_ms);
+  void FillActiveChannels(std::vector<Channel*>* active_channels);
+
+  int ring_fd_{-1};
+
+  // Submission ring.
+  void* sq_ring_{nullptr};
+  size_t sq_ring_size_{0};
+  uint32_t* sq_head_{nullptr};
+  uint32_t* sq_tail_{nullptr};
+  uint32_t sq_mask_{0};
+  uint32_t sq_entries_{0};
+  uint32_t* sq_array_{nullptr};
+  io_uring_sqe* sqes_{nullptr};
+  size_t sqes_size_{0};
+  // SQEs filled but not submitted yet.
+  uint32_t sq_pending_{0};
+
+  // Completion ring, may share the mapping with the submission ring.
+  void* cq_ring_{nullptr};
+  size_t cq_ring_size_{0};
+  uint32_t* cq_head_{nullptr};
+  uint32_t* cq_tail_{nullptr};
+  uint32_t cq_mask_{0};
+  io_uring_cqe* cqes_{nullptr};
+
+  // Indexed by fd.
+  std::vector<Registration> registrations_;
+  // One-shot requests completed, re-armed before polling again.
+  std::vector<int> rearm_fds_;
+};
+
+}  // namespace net
+}  // namespace jinduo
@@ -0,0 +1,90 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is an internal header file, you should not include this.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace jinduo {
+namespace net {
+
+// A sequence lock publishing a trivially copyable value from a single writer
+// to any number of readers.
+//
+// The writer never waits, a reader retries if it overlaps a write. The value
+// is kept in atomic words, so a torn read is detected instead of being a data
+// race. It takes cache lines of its own, apart from the writer's data.
+template <typename T>
+class alignas(64) SeqLock {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "SeqLock requires a trivially copyable type.");
+
+ public:
+  SeqLock() { Store(T{}); }
+  ~SeqLock() = default;
+
+  // Disallow copy.
+  SeqLock(const SeqLock&) noexcept = delete;
+  SeqLock& operator=(const SeqLock&) noexcept = delete;
+
+  // Disallow move.
+  SeqLock(SeqLock&&) noexcept = delete;
+  SeqLock& operator=(SeqLock&&) noexcept = delete;
+
+  // Must be called by one thread at a time.
+  void Store(const T& value) {
+    uint64_t words[kWords] = {};
+    std::memcpy(words, &value, sizeof(T));
+    const uint64_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  // Safe to call from any thread.
+  T Load() const {
+    uint64_t words[kWords];
+    uint64_t seq = 0;
+    do {
+      seq = seq_.load(std::memory_order_acquire);
+      for (size_t i = 0; i < kWords; ++i) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) != 0 || seq != seq_.load(std::memory_order_relaxed));
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+ private:
+  static constexpr size_t kWords = (sizeof(T) + 7) / 8;
+
+  std::atomic<uint64_t> seq_{0};
+  std::atomic<uint64_t> words_[kWords];
+};
+
+}  // namespace net
+}  // namespace jinduo
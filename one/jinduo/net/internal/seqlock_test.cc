@@ -0,0 +1,75 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/internal/seqlock.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+using jinduo::net::SeqLock;
+
+namespace {
+
+struct Value {
+  int64_t a{0};
+  int64_t b{0};
+  int32_t c{0};
+};
+
+}  // namespace
+
+TEST(SeqLock, StoreLoad) {
+  SeqLock<Value> lock;
+  Value value = lock.Load();
+  EXPECT_EQ(value.a, 0);
+  EXPECT_EQ(value.b, 0);
+  EXPECT_EQ(value.c, 0);
+
+  lock.Store(Value{1, 2, 3});
+  value = lock.Load();
+  EXPECT_EQ(value.a, 1);
+  EXPECT_EQ(value.b, 2);
+  EXPECT_EQ(value.c, 3);
+}
+
+TEST(SeqLock, NoTornRead) {
+  constexpr int64_t kStores = 200000;
+  SeqLock<Value> lock;
+  std::atomic<bool> done{false};
+
+  std::thread writer([&lock, &done] {
+    for (int64_t i = 1; i <= kStores; ++i) {
+      lock.Store(Value{i, -i, static_cast<int32_t>(i)});
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  int64_t last = 0;
+  while (!done.load(std::memory_order_acquire)) {
+    Value value = lock.Load();
+    ASSERT_EQ(value.b, -value.a);
+    ASSERT_EQ(value.c, static_cast<int32_t>(value.a));
+    // Never goes backward.
+    ASSERT_GE(value.a, last);
+    last = value.a;
+  }
+  writer.join();
+  EXPECT_EQ(lock.Load().a, kStores);
+}
@@ -130,5 +130,39 @@ void Socket::setKeepAlive(  // NOLINT(readability-make-member-function-const)
   // FIXME CHECK
 }
 
+void Socket::setBusyPoll(  // NOLINT(readability-make-member-function-const)
+    int usec) {
+#ifdef SO_BUSY_POLL
+  int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &usec,
+                         static_cast<socklen_t>(sizeof usec));
+  if (ret < 0) {
+    PLOG(ERROR) << "SO_BUSY_POLL failed.";
+  }
+#else
+  if (usec > 0) {
+    LOG(ERROR) << "SO_BUSY_POLL is not supported.";
+  }
+#endif
+}
+
+bool Socket::setZeroCopy(  // NOLINT(readability-make-member-function-const)
+    bool on) {
+#ifdef SO_ZEROCOPY
+  int optval = on ? 1 : 0;
+  int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval,
+                         static_cast<socklen_t>(sizeof optval));
+  if (ret < 0 && on) {
+    PLOG(ERROR) << "SO_ZEROCOPY failed.";
+    return false;
+  }
+  return true;
+#else
+  if (on) {
+    LOG(ERROR) << "SO_ZEROCOPY is not supported.";
+  }
+  return !on;
+#endif
+}
+
 }  // namespace net
 }  // namespace jinduo
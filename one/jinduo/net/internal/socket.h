@@ -81,6 +81,14 @@ class Socket {
   // Enable/disable SO_KEEPALIVE
   void setKeepAlive(bool on);
 
+  // Sets SO_BUSY_POLL, the time in microseconds the kernel may busy poll the
+  // device queue on a blocking read or poll, 0 to disable.
+  void setBusyPoll(int usec);
+
+  // Enables SO_ZEROCOPY, so that sockets::sendZeroCopy may be used.
+  // Returns false if it's not supported.
+  bool setZeroCopy(bool on);
+
  private:
   const int sockfd_;
 };
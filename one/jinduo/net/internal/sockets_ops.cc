@@ -27,9 +27,12 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
 #include <stdio.h>  // snprintf
+#include <sys/sendfile.h>
 #include <sys/socket.h>
-#include <sys/uio.h>  // readv
+#include <sys/uio.h>  // readv, writev
 #include <unistd.h>
 
 #include "absl/base/casts.h"
@@ -184,6 +187,57 @@ ssize_t sockets::write(int sockfd, const void* buf, size_t count) {
   return ::write(sockfd, buf, count);
 }
 
+ssize_t sockets::writev(int sockfd, const struct iovec* iov, int iovcnt) {
+  return ::writev(sockfd, iov, iovcnt);
+}
+
+ssize_t sockets::sendfile(int sockfd, int infd, off_t* offset, size_t count) {
+  return ::sendfile(sockfd, infd, offset, count);
+}
+
+ssize_t sockets::splice(int sockfd, int infd, size_t count) {
+  return ::splice(infd, nullptr, sockfd, nullptr, count,
+                  SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+}
+
+ssize_t sockets::sendZeroCopy(int sockfd, const struct iovec* iov,
+                              int iovcnt) {
+  struct msghdr msg {};
+  msg.msg_iov = const_cast<struct iovec*>(iov);
+  msg.msg_iovlen = iovcnt;
+  return ::sendmsg(sockfd, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+}
+
+bool sockets::recvZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi,
+                                     bool* copied) {
+  // Skips the other errors queued, if any.
+  while (true) {
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err)) +
+                 CMSG_SPACE(sizeof(struct sockaddr_in6))];
+    struct msghdr msg {};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    if (::recvmsg(sockfd, &msg, MSG_ERRQUEUE) < 0) {
+      return false;
+    }
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+          !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+      const auto* err =
+          reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+      if (err->ee_errno == 0 && err->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+        *lo = err->ee_info;
+        *hi = err->ee_data;
+        *copied = (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+        return true;
+      }
+    }
+  }
+}
+
 void sockets::close(int sockfd) {
   if (::close(sockfd) < 0) {
     LOG(ERROR) << "sockets::close";
@@ -255,6 +309,15 @@ int sockets::getSocketError(int sockfd) {
   return optval;
 }
 
+int sockets::getIncomingCpu(int sockfd) {
+  int cpu = -1;
+  auto optlen = static_cast<socklen_t>(sizeof cpu);
+  if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &optlen) < 0) {
+    return -1;
+  }
+  return cpu;
+}
+
 struct sockaddr_in6 sockets::getLocalAddr(int sockfd) {
   sockaddr_in6 localaddr{};
   ::memset(&localaddr, 0, sizeof(localaddr));
@@ -44,6 +44,19 @@ int accept(int sockfd, struct sockaddr_in6* addr);
 ssize_t read(int sockfd, void* buf, size_t count);
 ssize_t readv(int sockfd, const struct iovec* iov, int iovcnt);
 ssize_t write(int sockfd, const void* buf, size_t count);
+ssize_t writev(int sockfd, const struct iovec* iov, int iovcnt);
+ssize_t sendfile(int sockfd, int infd, off_t* offset, size_t count);
+// infd must be a pipe.
+ssize_t splice(int sockfd, int infd, size_t count);
+// Sends with MSG_ZEROCOPY, the pages are read by the kernel after it returns,
+// until the completion shows up in the error queue. The successful sends are
+// numbered from 0 on.
+ssize_t sendZeroCopy(int sockfd, const struct iovec* iov, int iovcnt);
+// Reads the next completion off the error queue, which covers the zero-copy
+// sends numbered [*lo, *hi]. *copied is set if the kernel fell back to copy.
+// Returns false once there's none.
+bool recvZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi,
+                            bool* copied);
 void close(int sockfd);
 void shutdownWrite(int sockfd);
 
@@ -54,6 +67,8 @@ void fromIpPort(const char* ip, uint16_t port, struct sockaddr_in* addr);
 void fromIpPort(const char* ip, uint16_t port, struct sockaddr_in6* addr);
 
 int getSocketError(int sockfd);
+// The CPU which handled the packets of the socket lately, -1 if unknown.
+int getIncomingCpu(int sockfd);
 
 const struct sockaddr* sockaddr_cast(const struct sockaddr_in* addr);
 const struct sockaddr* sockaddr_cast(const struct sockaddr_in6* addr);
@@ -32,11 +32,31 @@ std::atomic<int64_t> Timer::s_numCreated_;
 
 void Timer::restart(absl::Time now) {
   if (repeat_) {
-    expiration_ = now + interval_;
+    // Fired late within the slack, the lateness doesn't add up over periods.
+    const absl::Time next = expiration_ + interval_;
+    expiration_ =
+        slack_ > absl::ZeroDuration() && next > now ? next : now + interval_;
   } else {
     expiration_ = absl::InfinitePast();
   }
 }
 
+void Timer::reset(TimerCallback cb, absl::Time when, absl::Duration interval,
+                  absl::Duration slack) {
+  callback_ = std::move(cb);
+  expiration_ = when;
+  interval_ = interval;
+  slack_ = slack;
+  repeat_ = interval > absl::ZeroDuration();
+  canceled_ = false;
+  sequence_ = s_numCreated_.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+void Timer::release() {
+  callback_ = nullptr;
+  canceled_ = false;
+  sequence_ = 0;
+}
+
 }  // namespace net
 }  // namespace jinduo
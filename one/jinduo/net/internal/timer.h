@@ -33,19 +33,20 @@
 
 #include "absl/time/time.h"
 #include "one/jinduo/net/callbacks.h"
+#include "one/jinduo/net/internal/timing_wheel.h"
 
 namespace jinduo {
 namespace net {
 
-// Internal class for timer event.
-class Timer {
+// Linked into the timing wheel of the TimerQueue. Timers are pooled & reused
+// by the TimerQueue, a new sequence is assigned each time, so a stale TimerId
+// never matches.
+class Timer : public TimingWheel::Node {
  public:
-  Timer(TimerCallback cb, absl::Time when, absl::Duration interval)
-      : callback_(std::move(cb)),
-        expiration_(when),
-        interval_(interval),
-        repeat_(interval > absl::ZeroDuration()),
-        sequence_(s_numCreated_.fetch_add(1, std::memory_order_acq_rel) + 1) {}
+  Timer(TimerCallback cb, absl::Time when, absl::Duration interval,
+        absl::Duration slack) {
+    reset(std::move(cb), when, interval, slack);
+  }
   ~Timer() = default;
 
   // Disallow copy.
@@ -59,21 +60,36 @@ class Timer {
   void run() const { callback_(); }
 
   [[nodiscard]] absl::Time expiration() const { return expiration_; }
+  // How late it may fire.
+  [[nodiscard]] absl::Duration slack() const { return slack_; }
   [[nodiscard]] bool repeat() const { return repeat_; }
   [[nodiscard]] int64_t sequence() const { return sequence_; }
 
+  // Canceled while it's not in the wheel, i.e. running or not added yet.
+  [[nodiscard]] bool canceled() const { return canceled_; }
+  void cancel() { canceled_ = true; }
+
   void restart(absl::Time now);
 
+  // Reuses a released timer.
+  void reset(TimerCallback cb, absl::Time when, absl::Duration interval,
+             absl::Duration slack);
+
+  // Drops the callback & invalidates the TimerId of it.
+  void release();
+
   static int64_t numCreated() {
     return s_numCreated_.load(std::memory_order_acquire);
   }
 
  private:
-  const TimerCallback callback_;
+  TimerCallback callback_;
   absl::Time expiration_;
-  const absl::Duration interval_;
-  const bool repeat_;
-  const int64_t sequence_;
+  absl::Duration interval_;
+  absl::Duration slack_;
+  bool repeat_{false};
+  bool canceled_{false};
+  int64_t sequence_{0};
 
   static std::atomic<int64_t> s_numCreated_;
 };
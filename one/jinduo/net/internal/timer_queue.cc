@@ -86,11 +86,13 @@ void resetTimerfd(int timerfd, absl::Time expiration) {
 
 }  // namespace details
 
+constexpr absl::Duration TimerQueue::kTick;
+
 TimerQueue::TimerQueue(EventLoop* loop)
     : loop_(loop),
       timerfd_(details::createTimerfd()),
       timerfdChannel_(loop, timerfd_),
-      callingExpiredTimers_(false) {
+      epoch_(absl::Now()) {
   timerfdChannel_.SetReadCallback(
       [this](absl::Time /*ignored*/) { handleRead(); });
   // we are always reading the timerfd, we disarm it with timerfd_settime.
@@ -102,16 +104,25 @@ TimerQueue::~TimerQueue() {
   timerfdChannel_.RemoveFromOwnerEventLoop();
   ::close(timerfd_);
   // do not remove channel, since we're in EventLoop::dtor();
-  for (const Entry& timer : timers_) {
-    delete timer.second;
-  }
+  // The timers added from other threads but not in loop yet are leaked, as
+  // before.
 }
 
 TimerId TimerQueue::addTimer(TimerCallback cb, absl::Time when,
-                             absl::Duration interval) {
-  auto* timer = new Timer(std::move(cb), when, interval);
-  loop_->RunInLoop(absl::bind_front(&TimerQueue::addTimerInLoop, this, timer));
-  return {timer, timer->sequence()};
+                             absl::Duration interval, absl::Duration slack) {
+  if (loop_->IsInLoopThread()) {
+    Timer* timer = allocateTimer(std::move(cb), when, interval, slack);
+    addTimerInLoop(timer);
+    return {timer, timer->sequence()};
+  }
+  // The pool is only touched in the loop thread, it's adopted in there.
+  auto* timer = new Timer(std::move(cb), when, interval, slack);
+  TimerId timerId(timer, timer->sequence());
+  loop_->RunInLoop([this, timer] {
+    timers_.emplace_back(timer);
+    addTimerInLoop(timer);
+  });
+  return timerId;
 }
 
 void TimerQueue::cancel(TimerId timerId) {
@@ -120,118 +131,122 @@ void TimerQueue::cancel(TimerId timerId) {
 
 void TimerQueue::addTimerInLoop(Timer* timer) {
   loop_->AssertInLoopThread();
-  bool earliestChanged = insert(timer);
-
-  if (earliestChanged) {
-    details::resetTimerfd(timerfd_, timer->expiration());
+  if (timer->canceled()) {
+    releaseTimer(timer);
+    return;
   }
+  insert(timer);
 }
 
 void TimerQueue::cancelInLoop(TimerId timerId) {
   loop_->AssertInLoopThread();
-  assert(timers_.size() == activeTimers_.size());
-  ActiveTimer timer(timerId.timer_, timerId.sequence_);
-  auto it = activeTimers_.find(timer);
-  if (it != activeTimers_.end()) {
-    size_t n = timers_.erase(Entry(it->first->expiration(), it->first));
-    assert(n == 1);
-    (void)n;
-    delete it->first;  // FIXME: no delete please
-    activeTimers_.erase(it);
-  } else if (callingExpiredTimers_) {
-    cancelingTimers_.insert(timer);
+  Timer* timer = timerId.timer_;
+  if (timer == nullptr || timer->sequence() != timerId.sequence_) {
+    // Already fired or canceled, the timer may be reused by another one.
+    return;
+  }
+  if (timer->linked()) {
+    wheel_.Remove(timer);
+    releaseTimer(timer);
+  } else {
+    // It's running in handleRead(), released after that.
+    timer->cancel();
   }
-  assert(timers_.size() == activeTimers_.size());
 }
 
 void TimerQueue::handleRead() {
   loop_->AssertInLoopThread();
   absl::Time now = absl::Now();
   details::readTimerfd(timerfd_, now);
+  armedTick_ = TimingWheel::kNever;
 
-  std::vector<Entry> expired = getExpired(now);
+  expired_.clear();
+  wheel_.Advance(absl::ToInt64Milliseconds(now - epoch_), &expired_);
 
-  callingExpiredTimers_ = true;
-  cancelingTimers_.clear();
   // safe to callback outside critical section
-  for (const Entry& it : expired) {
-    it.second->run();
-  }
-  callingExpiredTimers_ = false;
-
-  reset(expired, now);
-}
-
-std::vector<TimerQueue::Entry> TimerQueue::getExpired(absl::Time now) {
-  assert(timers_.size() == activeTimers_.size());
-  std::vector<Entry> expired;
-  Entry sentry(now,
-               reinterpret_cast<Timer*>(  // NOLINT(performance-no-int-to-ptr)
-                   UINTPTR_MAX));
-  auto end = timers_.lower_bound(sentry);
-  assert(end == timers_.end() || now < end->first);
-  std::copy(timers_.begin(), end, back_inserter(expired));
-  timers_.erase(timers_.begin(), end);
-
-  for (const Entry& it : expired) {
-    ActiveTimer timer(it.second, it.second->sequence());
-    size_t n = activeTimers_.erase(timer);
-    assert(n == 1);
-    (void)n;
+  for (TimingWheel::Node* node : expired_) {
+    auto* timer = static_cast<Timer*>(node);
+    if (!timer->canceled()) {
+      timer->run();
+    }
   }
 
-  assert(timers_.size() == activeTimers_.size());
-  return expired;
-}
-
-void TimerQueue::reset(const std::vector<Entry>& expired, absl::Time now) {
-  absl::Time nextExpire;
-
-  for (const Entry& it : expired) {
-    ActiveTimer timer(it.second, it.second->sequence());
-    if (it.second->repeat() &&
-        cancelingTimers_.find(timer) == cancelingTimers_.end()) {
-      it.second->restart(now);
-      insert(it.second);
+  for (TimingWheel::Node* node : expired_) {
+    auto* timer = static_cast<Timer*>(node);
+    if (timer->repeat() && !timer->canceled()) {
+      timer->restart(now);
+      insert(timer);
     } else {
-      // FIXME move to a free list
-      delete it.second;  // FIXME: no delete please
+      releaseTimer(timer);
     }
   }
+  expired_.clear();
 
-  if (!timers_.empty()) {
-    nextExpire = timers_.begin()->second->expiration();
-  }
+  rearm();
+}
 
-  if (nextExpire != absl::InfinitePast()) {
-    details::resetTimerfd(timerfd_, nextExpire);
+Timer* TimerQueue::allocateTimer(TimerCallback cb, absl::Time when,
+                                 absl::Duration interval,
+                                 absl::Duration slack) {
+  if (freeTimers_.empty()) {
+    timers_.push_back(
+        std::make_unique<Timer>(std::move(cb), when, interval, slack));
+    return timers_.back().get();
   }
+  Timer* timer = freeTimers_.back();
+  freeTimers_.pop_back();
+  timer->reset(std::move(cb), when, interval, slack);
+  return timer;
 }
 
-bool TimerQueue::insert(Timer* timer) {
+void TimerQueue::releaseTimer(Timer* timer) {
+  timer->release();
+  freeTimers_.push_back(timer);
+}
+
+void TimerQueue::insert(Timer* timer) {
   loop_->AssertInLoopThread();
-  assert(timers_.size() == activeTimers_.size());
-  bool earliestChanged = false;
-  absl::Time when = timer->expiration();
-  auto it = timers_.begin();
-  if (it == timers_.end() || when < it->first) {
-    earliestChanged = true;
+  wheel_.Insert(timer, coalescedTick(timer));
+  rearm();
+}
+
+int64_t TimerQueue::coalescedTick(const Timer* timer) const {
+  return coalescedTick(tickOf(timer->expiration()),
+                       absl::ToInt64Milliseconds(timer->slack()),
+                       wheel_.current_tick(), armedTick_);
+}
+
+// static
+int64_t TimerQueue::coalescedTick(int64_t tick, int64_t slack,
+                                  int64_t currentTick, int64_t armedTick) {
+  if (slack <= 0 || tick < currentTick) {
+    return tick;
   }
-  {
-    std::pair<TimerList::iterator, bool> result =
-        timers_.insert(Entry(when, timer));
-    assert(result.second);
-    (void)result;
+  // No reprogramming at all if it could go with the armed one.
+  if (armedTick >= tick && armedTick - tick <= slack) {
+    return armedTick;
   }
-  {
-    std::pair<ActiveTimerSet::iterator, bool> result =
-        activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
-    assert(result.second);
-    (void)result;
+  // Rounded up to a multiple of the largest power of 2 within the slack, the
+  // timers with the similar slack meet there.
+  const int64_t align = int64_t{1} << (63 - __builtin_clzll(slack));
+  return (tick + align - 1) & ~(align - 1);
+}
+
+void TimerQueue::rearm() {
+  int64_t tick = wheel_.NextTick();
+  if (tick >= armedTick_) {
+    return;
   }
+  armedTick_ = tick;
+  details::resetTimerfd(timerfd_, timeOf(tick));
+}
+
+int64_t TimerQueue::tickOf(absl::Time when) const {
+  return absl::ToInt64Milliseconds(absl::Ceil(when - epoch_, kTick));
+}
 
-  assert(timers_.size() == activeTimers_.size());
-  return earliestChanged;
+absl::Time TimerQueue::timeOf(int64_t tick) const {
+  return epoch_ + tick * kTick;
 }
 
 }  // namespace net
@@ -27,12 +27,13 @@
 
 #pragma once
 
-#include <set>
+#include <memory>
 #include <utility>
 #include <vector>
 
 #include "one/jinduo/net/callbacks.h"
 #include "one/jinduo/net/internal/channel.h"
+#include "one/jinduo/net/internal/timing_wheel.h"
 
 namespace jinduo {
 namespace net {
@@ -41,10 +42,19 @@ class EventLoop;
 class Timer;
 class TimerId;
 
-// A best efforts timer queue.
-// No guarantee that the callback will be on time.
+// Timers are kept in a hierarchical timing wheel of 1ms ticks, so adding &
+// canceling are O(1) no matter how many timers are pending. A timer never
+// fires before its expiration, but may fire up to a tick later, or up to its
+// slack later.
+//
+// A timer with slack is moved to the tick the timerfd is armed for if it's
+// within the slack, otherwise to a round tick, a multiple of the largest power
+// of 2 within the slack, so the timers due around the same time are expired in
+// a single wakeup, and the timerfd is rarely reprogrammed for them.
 class TimerQueue {
  public:
+  static constexpr absl::Duration kTick = absl::Milliseconds(1);
+
   explicit TimerQueue(EventLoop* loop);
   ~TimerQueue();
 
@@ -60,39 +70,51 @@ class TimerQueue {
   // repeats if @c interval > 0.0.
   //
   // Must be thread safe. Usually be called from other threads.
-  TimerId addTimer(TimerCallback cb, absl::Time when, absl::Duration interval);
+  TimerId addTimer(TimerCallback cb, absl::Time when, absl::Duration interval,
+                   absl::Duration slack = absl::ZeroDuration());
 
   void cancel(TimerId timerId);
 
- private:
-  // FIXME: use unique_ptr<Timer> instead of raw pointers.
-  // This requires heterogeneous comparison lookup (N3465) from C++14
-  // so that we can find an T* in a set<unique_ptr<T>>.
-  using Entry = std::pair<absl::Time, Timer*>;
-  using TimerList = std::set<Entry>;
-  using ActiveTimer = std::pair<Timer*, int64_t>;
-  using ActiveTimerSet = std::set<ActiveTimer>;
+  // The tick to expire a timer due at `tick` within `slack` ticks, given the
+  // wheel is at `currentTick` & the timerfd is armed for `armedTick`.
+  [[nodiscard]] static int64_t coalescedTick(int64_t tick, int64_t slack,
+                                             int64_t currentTick,
+                                             int64_t armedTick);
 
+ private:
   void addTimerInLoop(Timer* timer);
   void cancelInLoop(TimerId timerId);
   // called when timerfd alarms
   void handleRead();
-  // move out all expired timers
-  std::vector<Entry> getExpired(absl::Time now);
-  void reset(const std::vector<Entry>& expired, absl::Time now);
 
-  bool insert(Timer* timer);
+  // Takes a released timer from the pool, or creates one if it's empty.
+  Timer* allocateTimer(TimerCallback cb, absl::Time when,
+                       absl::Duration interval, absl::Duration slack);
+  void releaseTimer(Timer* timer);
+
+  void insert(Timer* timer);
+  // The tick to expire the timer within its slack.
+  [[nodiscard]] int64_t coalescedTick(const Timer* timer) const;
+  // Arms the timerfd if the wheel has something due before it alarms.
+  void rearm();
+
+  // The first tick not earlier than `when`, so timers never fire early.
+  [[nodiscard]] int64_t tickOf(absl::Time when) const;
+  [[nodiscard]] absl::Time timeOf(int64_t tick) const;
 
   EventLoop* loop_;
   const int timerfd_;
   Channel timerfdChannel_;
-  // Timer list sorted by expiration
-  TimerList timers_;
-
-  // for cancel()
-  ActiveTimerSet activeTimers_;
-  bool callingExpiredTimers_; /* atomic */
-  ActiveTimerSet cancelingTimers_;
+  const absl::Time epoch_;
+  TimingWheel wheel_;
+  // The tick the timerfd is armed for.
+  int64_t armedTick_{TimingWheel::kNever};
+  std::vector<TimingWheel::Node*> expired_;
+
+  // Owns all the timers, released ones are kept in `freeTimers_` for reuse,
+  // so a stale TimerId always points to a valid timer.
+  std::vector<std::unique_ptr<Timer>> timers_;
+  std::vector<Timer*> freeTimers_;
 };
 
 }  // namespace net
@@ -33,10 +33,14 @@
 #include "one/jinduo/base/this_thread.h"
 #include "one/jinduo/net/event_loop.h"
 #include "one/jinduo/net/event_loop_thread.h"
+#include "one/jinduo/net/internal/timer.h"
+#include "one/jinduo/net/internal/timer_queue.h"
 
 using jinduo::net::EventLoop;
 using jinduo::net::EventLoopThread;
+using jinduo::net::Timer;
 using jinduo::net::TimerId;
+using jinduo::net::TimerQueue;
 
 int cnt = 0;
 EventLoop* g_loop;
@@ -57,11 +61,54 @@ void cancel(TimerId timer) {
   LOG(INFO) << "cancelled.";
 }
 
+void testCoalescedTick() {
+  // No slack, or due already.
+  CHECK_EQ(100, TimerQueue::coalescedTick(100, 0, 50, 120));
+  CHECK_EQ(40, TimerQueue::coalescedTick(40, 10, 50, 120));
+  // Joins the armed tick within the slack.
+  CHECK_EQ(105, TimerQueue::coalescedTick(100, 5, 50, 105));
+  CHECK_EQ(100, TimerQueue::coalescedTick(100, 5, 50, 100));
+  // Never earlier than due, nor later than the slack, rounded up to a
+  // multiple of the largest power of 2 within the slack instead.
+  CHECK_EQ(104, TimerQueue::coalescedTick(100, 10, 50, 99));
+  CHECK_EQ(104, TimerQueue::coalescedTick(100, 10, 50, 120));
+  CHECK_EQ(101, TimerQueue::coalescedTick(101, 1, 50, 120));
+  CHECK_EQ(102, TimerQueue::coalescedTick(101, 3, 50, 120));
+  CHECK_EQ(1024, TimerQueue::coalescedTick(600, 1000, 50, 2000));
+  LOG(INFO) << "coalescedTick passed.";
+}
+
+void testRestartDriftFree() {
+  const absl::Time start = absl::FromUnixSeconds(1000);
+  Timer timer([] {}, start, absl::Seconds(1), absl::Milliseconds(50));
+  // Fired late within the slack, the next one is still on the period.
+  timer.restart(start + absl::Milliseconds(30));
+  CHECK_EQ(start + absl::Seconds(1), timer.expiration());
+  timer.restart(start + absl::Milliseconds(1040));
+  CHECK_EQ(start + absl::Seconds(2), timer.expiration());
+  // Late by more than a period, it goes on from now.
+  timer.restart(start + absl::Seconds(5));
+  CHECK_EQ(start + absl::Seconds(6), timer.expiration());
+
+  // Without slack, from now.
+  Timer exact([] {}, start, absl::Seconds(1), absl::ZeroDuration());
+  exact.restart(start + absl::Milliseconds(30));
+  CHECK_EQ(start + absl::Milliseconds(1030), exact.expiration());
+
+  Timer once([] {}, start, absl::ZeroDuration(), absl::Milliseconds(50));
+  once.restart(start);
+  CHECK_EQ(absl::InfinitePast(), once.expiration());
+  LOG(INFO) << "restart passed.";
+}
+
 int main(int argc, char* argv[]) {
   google::InitGoogleLogging(argv[0]);
   google::InstallFailureSignalHandler();
   gflags::ParseCommandLineFlags(&argc, &argv, /*remove_flags=*/true);
 
+  testCoalescedTick();
+  testRestartDriftFree();
+
   printTid();
   sleep(1);
   {
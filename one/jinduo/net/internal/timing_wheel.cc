@@ -0,0 +1,205 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/internal/timing_wheel.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace jinduo {
+namespace net {
+
+constexpr int64_t TimingWheel::kNever;
+
+TimingWheel::TimingWheel(int64_t current_tick) : current_tick_(current_tick) {}
+
+void TimingWheel::Insert(Node* node, int64_t tick) {
+  assert(!node->linked());
+  node->wheel_tick = tick;
+  Link(node);
+  ++size_;
+}
+
+void TimingWheel::Remove(Node* node) {
+  assert(node->linked());
+  Unlink(node);
+  --size_;
+}
+
+void TimingWheel::Advance(int64_t tick, std::vector<Node*>* expired) {
+  // Jumps from one tick worth visiting to the next, the empty slots & the
+  // cascading of empty upper slots are skipped.
+  for (int64_t next = NextTick(); next <= tick; next = NextTick()) {
+    MoveTo(next);
+    const int index = static_cast<int>(current_tick_ & (kLowestSlots - 1));
+
+    const size_t first = expired->size();
+    Node* node = lowest_[index];
+    while (node != nullptr) {
+      Node* next_node = node->wheel_next;
+      Unlink(node);
+      if (node->wheel_tick > current_tick_) {
+        // Too far away for the top level when it's linked.
+        Link(node);
+      } else {
+        expired->push_back(node);
+        --size_;
+      }
+      node = next_node;
+    }
+    // Linked to the front, so the latest linked one comes first.
+    std::reverse(expired->begin() + static_cast<ptrdiff_t>(first),
+                 expired->end());
+    MoveTo(current_tick_ + 1);
+  }
+  MoveTo(std::max(current_tick_, tick + 1));
+}
+
+int64_t TimingWheel::NextTick() const {
+  if (size_ == 0) {
+    return kNever;
+  }
+  const int index = static_cast<int>(current_tick_ & (kLowestSlots - 1));
+  const int slot = NextLowestSlot(index);
+  if (slot < kLowestSlots) {
+    return current_tick_ + (slot - index);
+  }
+
+  // Nothing due in this round, it's either a slot of the lowest level in the
+  // next round, or the next upper slot to cascade, whichever comes first.
+  int64_t next = kNever;
+  const int wrapped = NextLowestSlot(0);
+  if (wrapped < kLowestSlots) {
+    next = current_tick_ - index + kLowestSlots + wrapped;
+  }
+  int shift = kLowestBits;
+  for (int level = 0; level < kUpperLevels; ++level, shift += kLevelBits) {
+    // The slots cascade at the multiples of `1 << shift`, the current one is
+    // done already.
+    const int64_t base = (current_tick_ >> shift) + 1;
+    for (int i = 0; i < kLevelSlots; ++i) {
+      if (upper_[level][(base + i) & (kLevelSlots - 1)] != nullptr) {
+        next = std::min(next, (base + i) << shift);
+        break;
+      }
+    }
+  }
+  return next;
+}
+
+void TimingWheel::MoveTo(int64_t tick) {
+  if (tick == current_tick_) {
+    return;
+  }
+  current_tick_ = tick;
+  if ((current_tick_ & (kLowestSlots - 1)) == 0) {
+    Cascade();
+  }
+}
+
+TimingWheel::Node*& TimingWheel::SlotHead(int level, int slot) {
+  return level == 0 ? lowest_[slot] : upper_[level - 1][slot];
+}
+
+void TimingWheel::Link(Node* node) {
+  const int64_t tick = std::max(node->wheel_tick, current_tick_);
+  const auto delta = static_cast<uint64_t>(tick - current_tick_);
+  int level = 0;
+  int slot = 0;
+  if (delta < kLowestSlots) {
+    slot = static_cast<int>(tick & (kLowestSlots - 1));
+    lowest_bitmap_[slot / 64] |= uint64_t{1} << (slot % 64);
+  } else {
+    int shift = kLowestBits;
+    int64_t clamped = tick;
+    for (level = 1; level < kUpperLevels; ++level, shift += kLevelBits) {
+      if (delta < uint64_t{1} << (shift + kLevelBits)) {
+        break;
+      }
+    }
+    if (level == kUpperLevels &&
+        delta >= uint64_t{1} << (shift + kLevelBits)) {
+      clamped = current_tick_ + (int64_t{1} << (shift + kLevelBits)) - 1;
+    }
+    slot = static_cast<int>((clamped >> shift) & (kLevelSlots - 1));
+  }
+
+  Node*& head = SlotHead(level, slot);
+  node->wheel_level = level;
+  node->wheel_slot = slot;
+  node->wheel_prev = nullptr;
+  node->wheel_next = head;
+  if (head != nullptr) {
+    head->wheel_prev = node;
+  }
+  head = node;
+}
+
+void TimingWheel::Unlink(Node* node) {
+  Node*& head = SlotHead(node->wheel_level, node->wheel_slot);
+  if (node->wheel_prev != nullptr) {
+    node->wheel_prev->wheel_next = node->wheel_next;
+  } else {
+    head = node->wheel_next;
+  }
+  if (node->wheel_next != nullptr) {
+    node->wheel_next->wheel_prev = node->wheel_prev;
+  }
+  if (node->wheel_level == 0 && head == nullptr) {
+    lowest_bitmap_[node->wheel_slot / 64] &=
+        ~(uint64_t{1} << (node->wheel_slot % 64));
+  }
+  node->wheel_prev = nullptr;
+  node->wheel_next = nullptr;
+  node->wheel_level = -1;
+}
+
+void TimingWheel::Cascade() {
+  int shift = kLowestBits;
+  for (int level = 1; level <= kUpperLevels; ++level, shift += kLevelBits) {
+    const int slot =
+        static_cast<int>((current_tick_ >> shift) & (kLevelSlots - 1));
+    Node* node = SlotHead(level, slot);
+    SlotHead(level, slot) = nullptr;
+    while (node != nullptr) {
+      Node* next = node->wheel_next;
+      node->wheel_level = -1;
+      Link(node);
+      node = next;
+    }
+    // The upper level goes on only if this one wraps around too.
+    if (slot != 0) {
+      break;
+    }
+  }
+}
+
+int TimingWheel::NextLowestSlot(int from) const {
+  for (int word = from / 64; word < kLowestSlots / 64; ++word) {
+    uint64_t bits = lowest_bitmap_[word];
+    if (word == from / 64) {
+      bits &= ~uint64_t{0} << (from % 64);
+    }
+    if (bits != 0) {
+      return word * 64 + __builtin_ctzll(bits);
+    }
+  }
+  return kLowestSlots;
+}
+
+}  // namespace net
+}  // namespace jinduo
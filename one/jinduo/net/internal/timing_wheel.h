@@ -0,0 +1,117 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is an internal header file, you should not include this.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace jinduo {
+namespace net {
+
+// A hierarchical timing wheel of intrusive nodes, counted in ticks.
+//
+// The lowest level has a slot per tick for the next 256 ticks, each upper
+// level has 64 slots, 64 times coarser than the level below. The nodes in an
+// upper slot cascade down when the lower level wraps around, like the classic
+// Linux kernel timers. So inserting & removing are O(1), a node is moved at
+// most once per level. The nodes due in more than 2^32 ticks wait at the
+// top level & are re-inserted until due.
+//
+// Not thread safe.
+class TimingWheel {
+ public:
+  // Embedded in the timers.
+  struct Node {
+    Node* wheel_prev{nullptr};
+    Node* wheel_next{nullptr};
+    int64_t wheel_tick{0};
+    // -1 if the node is not in any wheel.
+    int wheel_level{-1};
+    int wheel_slot{0};
+
+    [[nodiscard]] bool linked() const { return wheel_level >= 0; }
+  };
+
+  static constexpr int64_t kNever = std::numeric_limits<int64_t>::max();
+
+  // Starts with ticks before `current_tick` all passed.
+  explicit TimingWheel(int64_t current_tick = 0);
+  ~TimingWheel() = default;
+
+  // Disallow copy.
+  TimingWheel(const TimingWheel&) noexcept = delete;
+  TimingWheel& operator=(const TimingWheel&) noexcept = delete;
+
+  // Disallow move.
+  TimingWheel(TimingWheel&&) noexcept = delete;
+  TimingWheel& operator=(TimingWheel&&) noexcept = delete;
+
+  // Schedules the node at `tick`, a passed tick means the current one.
+  void Insert(Node* node, int64_t tick);
+
+  void Remove(Node* node);
+
+  // Passes all the ticks up to & including `tick`, appends the nodes due to
+  // `expired` in the order of ticks.
+  void Advance(int64_t tick, std::vector<Node*>* expired);
+
+  // The next tick worth advancing to, or `kNever` if it's empty. It's the
+  // earliest tick due in the lowest level, or when the earliest upper slot
+  // cascades down, which is no later than its nodes are due.
+  [[nodiscard]] int64_t NextTick() const;
+
+  // The earliest tick not passed yet.
+  [[nodiscard]] int64_t current_tick() const { return current_tick_; }
+
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+
+ private:
+  static constexpr int kLowestBits = 8;
+  static constexpr int kLowestSlots = 1 << kLowestBits;
+  static constexpr int kLevelBits = 6;
+  static constexpr int kLevelSlots = 1 << kLevelBits;
+  static constexpr int kUpperLevels = 4;
+
+  // Cascades when it's the start of a round, the jumps never skip a
+  // non-empty upper slot, see NextTick().
+  void MoveTo(int64_t tick);
+  Node*& SlotHead(int level, int slot);
+  // Links the node by its `wheel_tick`, relative to `current_tick_`.
+  void Link(Node* node);
+  void Unlink(Node* node);
+  // Moves the nodes in the current slot of the upper levels down.
+  void Cascade();
+  // Returns the first non-empty lowest slot at or after `from`, or
+  // `kLowestSlots` if none.
+  [[nodiscard]] int NextLowestSlot(int from) const;
+
+  int64_t current_tick_;
+  size_t size_{0};
+  std::array<Node*, kLowestSlots> lowest_{};
+  std::array<uint64_t, kLowestSlots / 64> lowest_bitmap_{};
+  std::array<std::array<Node*, kLevelSlots>, kUpperLevels> upper_{};
+};
+
+}  // namespace net
+}  // namespace jinduo
@@ -0,0 +1,145 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// Compares the timing wheel with the pair of `std::set` the TimerQueue used
+// to keep, by adding & canceling timers with many others pending, like the
+// idle timeouts of connections, and by expiring them.
+
+#include <cstdint>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "one/jinduo/net/internal/timing_wheel.h"
+
+namespace {
+
+using jinduo::net::TimingWheel;
+
+struct Timer : TimingWheel::Node {
+  int64_t sequence{0};
+};
+
+// The timers sorted by expiration & the active ones for canceling, as the
+// TimerQueue did.
+class SetQueue {
+ public:
+  void Insert(Timer* timer, int64_t tick) {
+    timer->wheel_tick = tick;
+    timers_.emplace(tick, timer);
+    active_.emplace(timer, timer->sequence);
+  }
+
+  void Remove(Timer* timer) {
+    auto it = active_.find({timer, timer->sequence});
+    timers_.erase({it->first->wheel_tick, it->first});
+    active_.erase(it);
+  }
+
+  void Advance(int64_t tick, std::vector<Timer*>* expired) {
+    auto end = timers_.lower_bound({tick + 1, nullptr});
+    for (auto it = timers_.begin(); it != end; ++it) {
+      expired->push_back(it->second);
+      active_.erase({it->second, it->second->sequence});
+    }
+    timers_.erase(timers_.begin(), end);
+  }
+
+ private:
+  std::set<std::pair<int64_t, Timer*>> timers_;
+  std::set<std::pair<Timer*, int64_t>> active_;
+};
+
+class WheelQueue {
+ public:
+  void Insert(Timer* timer, int64_t tick) { wheel_.Insert(timer, tick); }
+
+  void Remove(Timer* timer) { wheel_.Remove(timer); }
+
+  void Advance(int64_t tick, std::vector<Timer*>* expired) {
+    nodes_.clear();
+    wheel_.Advance(tick, &nodes_);
+    for (TimingWheel::Node* node : nodes_) {
+      expired->push_back(static_cast<Timer*>(node));
+    }
+  }
+
+ private:
+  TimingWheel wheel_;
+  std::vector<TimingWheel::Node*> nodes_;
+};
+
+// Up to a minute in 1ms ticks.
+int64_t RandomDelay(std::mt19937_64* rng) {
+  return 1 + static_cast<int64_t>((*rng)() % 60000);
+}
+
+// Re-arms a random timer out of `state.range(0)` pending ones per iteration,
+// like an idle timeout refreshed on every message.
+template <typename Queue>
+void BM_Rearm(benchmark::State& state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  std::mt19937_64 rng(42);
+  std::vector<Timer> timers(count);
+  Queue queue;
+  for (Timer& timer : timers) {
+    queue.Insert(&timer, RandomDelay(&rng));
+  }
+  int64_t sequence = 0;
+  for (auto _ : state) {
+    Timer& timer = timers[rng() % count];
+    queue.Remove(&timer);
+    timer.sequence = ++sequence;
+    queue.Insert(&timer, RandomDelay(&rng));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Expires the due ones out of `state.range(0)` pending timers per tick & adds
+// them back.
+template <typename Queue>
+void BM_Expire(benchmark::State& state) {
+  const auto count = static_cast<size_t>(state.range(0));
+  std::mt19937_64 rng(42);
+  std::vector<Timer> timers(count);
+  Queue queue;
+  for (Timer& timer : timers) {
+    queue.Insert(&timer, RandomDelay(&rng));
+  }
+  std::vector<Timer*> expired;
+  int64_t now = 0;
+  int64_t fired = 0;
+  for (auto _ : state) {
+    ++now;
+    expired.clear();
+    queue.Advance(now, &expired);
+    for (Timer* timer : expired) {
+      queue.Insert(timer, now + RandomDelay(&rng));
+    }
+    fired += static_cast<int64_t>(expired.size());
+  }
+  state.SetItemsProcessed(fired);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_Rearm, SetQueue)->Range(1 << 10, 1 << 17);
+BENCHMARK_TEMPLATE(BM_Rearm, WheelQueue)->Range(1 << 10, 1 << 17);
+BENCHMARK_TEMPLATE(BM_Expire, SetQueue)->Range(1 << 10, 1 << 17);
+BENCHMARK_TEMPLATE(BM_Expire, WheelQueue)->Range(1 << 10, 1 << 17);
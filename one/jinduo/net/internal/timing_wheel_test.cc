@@ -0,0 +1,164 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/internal/timing_wheel.h"
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using jinduo::net::TimingWheel;
+
+namespace {
+
+struct Timer : TimingWheel::Node {
+  int id{0};
+};
+
+std::vector<int> AdvanceTo(TimingWheel* wheel, int64_t tick) {
+  std::vector<TimingWheel::Node*> expired;
+  wheel->Advance(tick, &expired);
+  std::vector<int> ids;
+  for (TimingWheel::Node* node : expired) {
+    EXPECT_FALSE(node->linked());
+    EXPECT_LE(node->wheel_tick, tick);
+    ids.push_back(static_cast<Timer*>(node)->id);
+  }
+  return ids;
+}
+
+}  // namespace
+
+TEST(TimingWheel, ExpiresInOrder) {
+  TimingWheel wheel;
+  Timer timers[4];
+  const int64_t ticks[4] = {5, 3, 5, 1};
+  for (int i = 0; i < 4; ++i) {
+    timers[i].id = i;
+    wheel.Insert(&timers[i], ticks[i]);
+  }
+  EXPECT_EQ(wheel.size(), 4U);
+  EXPECT_EQ(wheel.NextTick(), 1);
+
+  EXPECT_TRUE(AdvanceTo(&wheel, 0).empty());
+  EXPECT_EQ(AdvanceTo(&wheel, 4), (std::vector<int>{3, 1}));
+  EXPECT_EQ(wheel.NextTick(), 5);
+  EXPECT_EQ(AdvanceTo(&wheel, 5), (std::vector<int>{0, 2}));
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_EQ(wheel.NextTick(), TimingWheel::kNever);
+  EXPECT_EQ(wheel.current_tick(), 6);
+}
+
+TEST(TimingWheel, PassedTickExpiresNext) {
+  TimingWheel wheel(100);
+  Timer timer;
+  wheel.Insert(&timer, 10);
+  EXPECT_EQ(wheel.NextTick(), 100);
+  EXPECT_EQ(AdvanceTo(&wheel, 100).size(), 1U);
+}
+
+TEST(TimingWheel, Remove) {
+  TimingWheel wheel;
+  Timer timers[3];
+  for (int i = 0; i < 3; ++i) {
+    timers[i].id = i;
+    wheel.Insert(&timers[i], 1000 * (i + 1));
+  }
+  wheel.Remove(&timers[1]);
+  EXPECT_FALSE(timers[1].linked());
+  EXPECT_EQ(wheel.size(), 2U);
+  EXPECT_EQ(AdvanceTo(&wheel, 10000), (std::vector<int>{0, 2}));
+}
+
+TEST(TimingWheel, CascadesUpperLevels) {
+  TimingWheel wheel(7);
+  Timer near;
+  Timer far;
+  wheel.Insert(&near, 300);
+  wheel.Insert(&far, int64_t{1} << 40);
+
+  // The cascading of `near` comes first.
+  EXPECT_EQ(wheel.NextTick(), 256);
+  EXPECT_TRUE(AdvanceTo(&wheel, 299).empty());
+  EXPECT_EQ(wheel.NextTick(), 300);
+  EXPECT_EQ(AdvanceTo(&wheel, 300).size(), 1U);
+
+  EXPECT_TRUE(AdvanceTo(&wheel, (int64_t{1} << 40) - 1).empty());
+  EXPECT_EQ(AdvanceTo(&wheel, int64_t{1} << 40).size(), 1U);
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimingWheel, InsertAfterIdleAdvance) {
+  TimingWheel wheel;
+  Timer pending;
+  Timer inserted;
+  wheel.Insert(&pending, 260);
+  // Stops right at the start of the round `pending` cascades into.
+  EXPECT_TRUE(AdvanceTo(&wheel, 255).empty());
+  wheel.Insert(&inserted, 300);
+  EXPECT_EQ(wheel.NextTick(), 260);
+  EXPECT_EQ(AdvanceTo(&wheel, 300).size(), 2U);
+}
+
+TEST(TimingWheel, MatchesOrderedMap) {
+  std::mt19937_64 rng(42);
+  TimingWheel wheel;
+  std::vector<Timer> timers(2000);
+  std::multimap<int64_t, Timer*> expected;
+  int64_t now = 0;
+
+  for (int round = 0; round < 200; ++round) {
+    for (Timer& timer : timers) {
+      if (timer.linked() && rng() % 8 == 0) {
+        wheel.Remove(&timer);
+        for (auto it = expected.begin(); it != expected.end(); ++it) {
+          if (it->second == &timer) {
+            expected.erase(it);
+            break;
+          }
+        }
+      } else if (!timer.linked() && rng() % 4 == 0) {
+        const int shift = static_cast<int>(rng() % 24);
+        const int64_t tick =
+            now + 1 + static_cast<int64_t>(rng() % (uint64_t{1} << shift));
+        wheel.Insert(&timer, tick);
+        expected.emplace(tick, &timer);
+      }
+    }
+    ASSERT_EQ(wheel.size(), expected.size());
+    if (!expected.empty()) {
+      ASSERT_LE(wheel.NextTick(), expected.begin()->first);
+    }
+
+    now += static_cast<int64_t>(rng() % (uint64_t{1} << (rng() % 20)));
+    std::vector<TimingWheel::Node*> expired;
+    wheel.Advance(now, &expired);
+    auto end = expected.upper_bound(now);
+    ASSERT_EQ(expired.size(),
+              static_cast<size_t>(std::distance(expected.begin(), end)));
+    int64_t last = 0;
+    for (TimingWheel::Node* node : expired) {
+      ASSERT_LE(node->wheel_tick, now);
+      ASSERT_LE(last, node->wheel_tick);
+      last = node->wheel_tick;
+    }
+    expected.erase(expected.begin(), end);
+  }
+}
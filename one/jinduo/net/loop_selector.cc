@@ -0,0 +1,123 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/loop_selector.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+namespace jinduo {
+namespace net {
+namespace {
+
+class RoundRobinSelector final : public LoopSelector {
+ public:
+  size_t Select(size_t num_loops,
+                absl::FunctionRef<LoopLoad(size_t)> /*load*/) override {
+    if (next_ >= num_loops) {
+      next_ = 0;
+    }
+    return next_++;
+  }
+
+ private:
+  size_t next_{0};
+};
+
+class LeastConnectionsSelector final : public LoopSelector {
+ public:
+  size_t Select(size_t num_loops,
+                absl::FunctionRef<LoopLoad(size_t)> load) override {
+    // Starts from the one after the last pick, so the ties are broken in
+    // round-robin.
+    size_t best = start_ % num_loops;
+    LoopLoad best_load = load(best);
+    for (size_t n = 1; n < num_loops; ++n) {
+      const size_t i = (start_ + n) % num_loops;
+      const LoopLoad candidate = load(i);
+      if (candidate.connections < best_load.connections ||
+          (candidate.connections == best_load.connections &&
+           candidate.queue_size < best_load.queue_size)) {
+        best = i;
+        best_load = candidate;
+      }
+    }
+    start_ = best + 1;
+    return best;
+  }
+
+ private:
+  size_t start_{0};
+};
+
+class PowerOfTwoChoicesSelector final : public LoopSelector {
+ public:
+  explicit PowerOfTwoChoicesSelector(uint64_t seed) : state_(seed) {}
+
+  size_t Select(size_t num_loops,
+                absl::FunctionRef<LoopLoad(size_t)> load) override {
+    if (num_loops == 1) {
+      return 0;
+    }
+    const size_t first = Next() % num_loops;
+    // A different one, uniformly.
+    const size_t second = (first + 1 + Next() % (num_loops - 1)) % num_loops;
+    return Lighter(load(second), load(first)) ? second : first;
+  }
+
+ private:
+  static constexpr double kBusyMargin = 0.05;
+
+  static bool Lighter(const LoopLoad& a, const LoopLoad& b) {
+    if (std::abs(a.busy - b.busy) > kBusyMargin) {
+      return a.busy < b.busy;
+    }
+    if (a.connections != b.connections) {
+      return a.connections < b.connections;
+    }
+    return a.queue_size < b.queue_size;
+  }
+
+  // splitmix64, good enough & cheap.
+  uint64_t Next() {
+    uint64_t z = (state_ += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t state_;
+};
+
+}  // namespace
+
+std::unique_ptr<LoopSelector> LoopSelector::NewRoundRobin() {
+  return std::make_unique<RoundRobinSelector>();
+}
+
+std::unique_ptr<LoopSelector> LoopSelector::NewLeastConnections() {
+  return std::make_unique<LeastConnectionsSelector>();
+}
+
+std::unique_ptr<LoopSelector> LoopSelector::NewPowerOfTwoChoices(
+    uint64_t seed) {
+  return std::make_unique<PowerOfTwoChoicesSelector>(seed);
+}
+
+}  // namespace net
+}  // namespace jinduo
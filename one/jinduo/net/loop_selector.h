@@ -0,0 +1,79 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is a public header file, it must only include public header files.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "absl/functional/function_ref.h"
+
+namespace jinduo {
+namespace net {
+
+// The live load of an io loop, as seen by a LoopSelector.
+struct LoopLoad {
+  // The connections established in the loop.
+  int64_t connections{0};
+  // The functors queued but not run yet.
+  size_t queue_size{0};
+  // The fraction of the recent wall time spent in handlers, in [0, 1].
+  double busy{0};
+};
+
+// Picks the io loop for a new connection out of an EventLoopThreadPool.
+//
+// Called in the base loop thread only, so it needn't be thread safe.
+class LoopSelector {
+ public:
+  LoopSelector() = default;
+  virtual ~LoopSelector() = default;
+
+  // Disallow copy.
+  LoopSelector(const LoopSelector&) noexcept = delete;
+  LoopSelector& operator=(const LoopSelector&) noexcept = delete;
+
+  // Disallow move.
+  LoopSelector(LoopSelector&&) noexcept = delete;
+  LoopSelector& operator=(LoopSelector&&) noexcept = delete;
+
+  // Returns the index of the loop out of `num_loops` > 0, `load` is asked for
+  // the candidates only, sampling a loop isn't free.
+  virtual size_t Select(size_t num_loops,
+                        absl::FunctionRef<LoopLoad(size_t)> load) = 0;
+
+  // Strict round-robin, the default, ignoring the loads.
+  static std::unique_ptr<LoopSelector> NewRoundRobin();
+
+  // The loop with the fewest connections, then the shortest queue. It samples
+  // all the loops on each selection.
+  static std::unique_ptr<LoopSelector> NewLeastConnections();
+
+  // The less loaded one of two loops chosen at random, so it samples only two
+  // loops, & a burst of selections doesn't pile onto a single loop, which
+  // looks the lightest until its load shows up. The recent busy time decides
+  // if it differs by more than 5%, so a few heavy connections count more than
+  // many light ones, otherwise the connections & the queue decide.
+  static std::unique_ptr<LoopSelector> NewPowerOfTwoChoices(
+      uint64_t seed = 0x9e3779b97f4a7c15);
+};
+
+}  // namespace net
+}  // namespace jinduo
@@ -0,0 +1,140 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// Simulates the io loops of a server taking long-lived connections of skewed
+// costs, to compare the tail latency under the loop selectors. A loop is
+// modeled as an M/M/1 queue, the latency of a request is 1 / (1 - busy) of
+// its service time, so the overloaded loops dominate the tail.
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "one/jinduo/net/loop_selector.h"
+
+namespace {
+
+using jinduo::net::LoopLoad;
+using jinduo::net::LoopSelector;
+
+constexpr size_t kNumLoops = 8;
+// 1 in 20 connections costs 40 times more, e.g. a bulk transfer among RPCs.
+constexpr double kLightCost = 0.001;
+constexpr double kHeavyCost = 0.04;
+constexpr int kHeavyOneIn = 20;
+// Connections alive in the steady state, making the loops ~60% busy overall.
+constexpr size_t kConnections = 1600;
+constexpr int kSteps = 200000;
+// The busy time seen by the selectors is sampled now & then, not live.
+constexpr int kBusySampleSteps = 50;
+constexpr double kMaxLatency = 100;
+
+struct Connection {
+  size_t loop{0};
+  double cost{0};
+};
+
+std::unique_ptr<LoopSelector> NewSelector(int policy) {
+  switch (policy) {
+    case 0:
+      return LoopSelector::NewRoundRobin();
+    case 1:
+      return LoopSelector::NewLeastConnections();
+    default:
+      return LoopSelector::NewPowerOfTwoChoices();
+  }
+}
+
+void BM_SkewedConnections(benchmark::State& state) {
+  std::vector<double> latencies;
+  double max_busy = 0;
+  for (auto _ : state) {
+    std::unique_ptr<LoopSelector> selector = NewSelector(state.range(0));
+    std::mt19937_64 rng(42);
+    std::vector<double> busy(kNumLoops);
+    std::vector<double> sampled_busy(kNumLoops);
+    std::vector<int64_t> connections(kNumLoops);
+    std::vector<Connection> alive;
+    alive.reserve(kConnections);
+    latencies.clear();
+    max_busy = 0;
+
+    for (int step = 0; step < kSteps; ++step) {
+      if (step % kBusySampleSteps == 0) {
+        sampled_busy = busy;
+      }
+      // A random connection leaves once it's full, & a new one comes.
+      if (alive.size() == kConnections) {
+        const size_t victim = rng() % alive.size();
+        busy[alive[victim].loop] -= alive[victim].cost;
+        --connections[alive[victim].loop];
+        alive[victim] = alive.back();
+        alive.pop_back();
+      }
+      Connection conn;
+      conn.cost = rng() % kHeavyOneIn == 0 ? kHeavyCost : kLightCost;
+      conn.loop = selector->Select(kNumLoops, [&](size_t i) {
+        LoopLoad load;
+        load.connections = connections[i];
+        load.busy = std::min(sampled_busy[i], 1.0);
+        return load;
+      });
+      busy[conn.loop] += conn.cost;
+      ++connections[conn.loop];
+      alive.push_back(conn);
+
+      // Samples the latency of a random request in the steady state, the
+      // heavy connections send more requests.
+      if (step >= kSteps / 2 && step % 10 == 0) {
+        const Connection& sampled = alive[rng() % alive.size()];
+        const double rho = busy[sampled.loop];
+        latencies.push_back(rho >= 1 - 1 / kMaxLatency ? kMaxLatency
+                                                        : 1 / (1 - rho));
+        max_busy = std::max(max_busy, rho);
+      }
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+  };
+  state.counters["p50"] = percentile(0.5);
+  state.counters["p99"] = percentile(0.99);
+  state.counters["p999"] = percentile(0.999);
+  state.counters["max_busy"] = max_busy;
+}
+
+// The cost of a selection, with the loads at hand.
+void BM_Select(benchmark::State& state) {
+  std::unique_ptr<LoopSelector> selector = NewSelector(state.range(0));
+  std::vector<LoopLoad> loads(kNumLoops);
+  for (auto _ : state) {
+    const size_t index = selector->Select(
+        kNumLoops, [&loads](size_t i) { return loads[i]; });
+    ++loads[index].connections;
+    benchmark::DoNotOptimize(index);
+  }
+}
+
+}  // namespace
+
+// 0: round-robin, 1: least connections, 2: power of two choices.
+BENCHMARK(BM_SkewedConnections)->DenseRange(0, 2)->Iterations(1);
+BENCHMARK(BM_Select)->DenseRange(0, 2);
@@ -0,0 +1,116 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/loop_selector.h"
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using jinduo::net::LoopLoad;
+using jinduo::net::LoopSelector;
+
+namespace {
+
+// Loads of the loops, & how many times they're sampled.
+struct FakeLoads {
+  std::vector<LoopLoad> loads;
+  int samples{0};
+
+  size_t Select(LoopSelector* selector) {
+    return selector->Select(loads.size(), [this](size_t index) {
+      ++samples;
+      return loads[index];
+    });
+  }
+};
+
+}  // namespace
+
+TEST(LoopSelector, RoundRobin) {
+  std::unique_ptr<LoopSelector> selector = LoopSelector::NewRoundRobin();
+  FakeLoads fake;
+  fake.loads.resize(3);
+  fake.loads[1].connections = 100;
+  EXPECT_EQ(0U, fake.Select(selector.get()));
+  EXPECT_EQ(1U, fake.Select(selector.get()));
+  EXPECT_EQ(2U, fake.Select(selector.get()));
+  EXPECT_EQ(0U, fake.Select(selector.get()));
+  // The loads are ignored.
+  EXPECT_EQ(0, fake.samples);
+}
+
+TEST(LoopSelector, LeastConnections) {
+  std::unique_ptr<LoopSelector> selector =
+      LoopSelector::NewLeastConnections();
+  FakeLoads fake;
+  fake.loads.resize(3);
+  fake.loads[0].connections = 5;
+  fake.loads[1].connections = 2;
+  fake.loads[2].connections = 2;
+  EXPECT_EQ(1U, fake.Select(selector.get()));
+  EXPECT_EQ(3, fake.samples);
+  // The ties are broken in round-robin.
+  EXPECT_EQ(2U, fake.Select(selector.get()));
+  EXPECT_EQ(1U, fake.Select(selector.get()));
+
+  // Then the shorter queue.
+  fake.loads[1].queue_size = 10;
+  EXPECT_EQ(2U, fake.Select(selector.get()));
+  EXPECT_EQ(2U, fake.Select(selector.get()));
+
+  fake.loads[0].connections = 0;
+  EXPECT_EQ(0U, fake.Select(selector.get()));
+}
+
+TEST(LoopSelector, PowerOfTwoChoices) {
+  std::unique_ptr<LoopSelector> selector =
+      LoopSelector::NewPowerOfTwoChoices(/*seed=*/42);
+  FakeLoads fake;
+  fake.loads.resize(1);
+  EXPECT_EQ(0U, fake.Select(selector.get()));
+  EXPECT_EQ(0, fake.samples);
+
+  // Two distinct loops are sampled, so the heaviest one is never picked.
+  fake.loads.resize(4);
+  fake.loads[3].busy = 0.9;
+  std::vector<int> picks(fake.loads.size());
+  for (int i = 0; i < 100; ++i) {
+    ++picks[fake.Select(selector.get())];
+  }
+  EXPECT_EQ(200, fake.samples);
+  EXPECT_EQ(0, picks[3]);
+  EXPECT_GT(picks[0], 0);
+  EXPECT_GT(picks[1], 0);
+  EXPECT_GT(picks[2], 0);
+
+  // The busy time within the margin, the connections decide.
+  fake.loads.resize(2);
+  fake.loads[0].busy = 0.52;
+  fake.loads[0].connections = 1;
+  fake.loads[1].busy = 0.5;
+  fake.loads[1].connections = 3;
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(0U, fake.Select(selector.get()));
+  }
+  // Beyond it, the busy time does.
+  fake.loads[0].busy = 0.6;
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(1U, fake.Select(selector.get()));
+  }
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+//
+// This is a public header file, it must only include public header files.
+
+#pragma once
+
+#include <assert.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "one/jinduo/net/buffer.h"
+
+namespace jinduo {
+namespace net {
+
+using Bytes = std::string;
+
+/// A read-only view of bytes which shares the ownership of its storage.
+///
+/// Copying a slice only bumps a reference count, so the same payload could be
+/// queued to many connections with a single allocation. The storage is freed
+/// after the last connection has written it out.
+class Slice {
+ public:
+  Slice() = default;
+
+  explicit Slice(std::shared_ptr<const Bytes> bytes)
+      : data_(bytes->data()), size_(bytes->size()), owner_(std::move(bytes)) {}
+
+  Slice(std::shared_ptr<const void> owner, const char* data, size_t size)
+      : data_(data), size_(size), owner_(std::move(owner)) {}
+
+  // implicit copy-ctor, move-ctor, dtor and assignment are fine
+
+  /// Takes the ownership of @c str without copying its content.
+  static Slice fromString(std::string&& str) {
+    return Slice(std::make_shared<const Bytes>(std::move(str)));
+  }
+
+  /// Takes the readable bytes of @c buf without copying them.
+  static Slice fromBuffer(Buffer&& buf) {
+    auto owner = std::make_shared<const Buffer>(std::move(buf));
+    return {owner, owner->peek(), owner->readableBytes()};
+  }
+
+  [[nodiscard]] const char* data() const { return data_; }
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+
+  [[nodiscard]] std::string_view toStringView() const { return {data_, size_}; }
+
+  void removePrefix(size_t n) {
+    assert(n <= size_);
+    data_ += n;
+    size_ -= n;
+  }
+
+ private:
+  const char* data_{nullptr};
+  size_t size_{0};
+  std::shared_ptr<const void> owner_;
+};
+
+}  // namespace net
+}  // namespace jinduo
@@ -122,16 +122,17 @@ void TcpClient::stop() {
 void TcpClient::newConnection(int sockfd) {
   loop_->AssertInLoopThread();
   InetAddress peerAddr(sockets::getPeerAddr(sockfd));
+  const int connId = nextConnId_++;
   char buf[32];
-  snprintf(buf, sizeof buf, ":%s#%d", peerAddr.toIpPort().c_str(), nextConnId_);
-  ++nextConnId_;
+  snprintf(buf, sizeof buf, ":%s#%d", peerAddr.toIpPort().c_str(), connId);
   std::string connName = name_ + buf;
 
   InetAddress localAddr(sockets::getLocalAddr(sockfd));
   // FIXME poll with zero timeout to double confirm the new connection
   // FIXME use make_shared if necessary
   std::shared_ptr<TcpConnection> conn(
-      new TcpConnection(loop_, connName, sockfd, localAddr, peerAddr));
+      new TcpConnection(loop_, connName, sockfd, localAddr, peerAddr,
+                        static_cast<ConnectionId>(connId)));
 
   conn->setConnectionCallback(connectionCallback_);
   conn->setMessageCallback(messageCallback_);
@@ -26,14 +26,21 @@
 #include "one/jinduo/net/tcp_connection.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <utility>
+#include <vector>
 
+#include "absl/base/casts.h"
 #include "absl/functional/bind_front.h"
 #include "glog/logging.h"
 #include "one/jinduo/base/strerror.h"
 #include "one/jinduo/net/event_loop.h"
+#include "one/jinduo/net/internal/buffer_pool.h"
 #include "one/jinduo/net/internal/channel.h"
+#include "one/jinduo/net/internal/idle_timeouts.h"
 #include "one/jinduo/net/internal/socket.h"
 #include "one/jinduo/net/internal/sockets_ops.h"
 
@@ -53,18 +60,51 @@ void defaultMessageCallback(const std::shared_ptr<TcpConnection>&, Buffer* buf,
   buf->retrieveAll();
 }
 
+void defaultConnectionTimeoutCallback(
+    const std::shared_ptr<TcpConnection>& conn, ConnectionTimeout timeout) {
+  VLOG(1) << "TcpConnection [" << conn->name() << "] timed out, "
+          << static_cast<int>(timeout);
+  conn->forceClose();
+}
+
+namespace {
+
+// The counters are written in the loop thread only, no need for a locked add.
+void addRelaxed(std::atomic<int64_t>* counter, int64_t delta) {
+  counter->store(counter->load(std::memory_order_relaxed) + delta,
+                 std::memory_order_relaxed);
+}
+
+}  // namespace
+
+const size_t TcpConnection::kMinReadSize;
+const size_t TcpConnection::kInitialReadSize;
+const size_t TcpConnection::kShrinkCapacity;
+
 TcpConnection::TcpConnection(EventLoop* loop, std::string nameArg, int sockfd,
                              const InetAddress& localAddr,
-                             const InetAddress& peerAddr)
+                             const InetAddress& peerAddr, ConnectionId id)
     : loop_(CHECK_NOTNULL(loop)),
       name_(std::move(nameArg)),
+      id_(id),
       state_(kConnecting),
       reading_(true),
       socket_(new Socket(sockfd)),
       channel_(new Channel(loop, sockfd)),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024) {
+      highWaterMark_(64 * 1024 * 1024),
+      readBudget_(0),
+      readSize_(kInitialReadSize),
+      smallReads_(0),
+      inputBuffer_(0),
+      outputBuffer_(loop->buffer_pool()),
+      creationTime_(absl::Now()),
+      lastReadNanos_(absl::ToUnixNanos(creationTime_)),
+      lastWriteNanos_(absl::ToUnixNanos(creationTime_)) {
+  // The input buffer draws memory from the loop pool on demand, and gives it
+  // back once drained, so an idle connection holds none.
+  inputBuffer_.releaseStorage();
   channel_->SetReadCallback(absl::bind_front(&TcpConnection::handleRead, this));
   channel_->SetWriteCallback(
       absl::bind_front(&TcpConnection::handleWrite, this));
@@ -80,7 +120,7 @@ TcpConnection::TcpConnection(EventLoop* loop, std::string nameArg, int sockfd,
 TcpConnection::~TcpConnection() {
   VLOG(1) << "TcpConnection::dtor[" << name_ << "] at " << this
           << " fd=" << channel_->fd() << " state=" << stateToString();
-  assert(state_ == kDisconnected);
+  assert(state() == kDisconnected);
 }
 
 bool TcpConnection::getTcpInfo(struct tcp_info* tcpi) const {
@@ -100,33 +140,84 @@ void TcpConnection::send(const void* message, int len) {
 }
 
 void TcpConnection::send(const std::string_view& message) {
-  if (state_ == kConnected) {
+  if (state() == kConnected) {
     if (loop_->IsInLoopThread()) {
       sendInLoop(message);
     } else {
-      void (TcpConnection::*fp)(const std::string_view& message) =
-          &TcpConnection::sendInLoop;
-      loop_->RunInLoop(absl::bind_front(fp,
-                                        this,  // FIXME
-                                        std::string(message)));
-      // std::forward<std::string>(message)));
+      send(std::string(message));
+    }
+  }
+}
+
+void TcpConnection::send(std::string&& message) {
+  if (state() == kConnected) {
+    if (loop_->IsInLoopThread()) {
+      sendInLoop(std::move(message));
+    } else {
+      loop_->RunInLoop([self = shared_from_this(),
+                        message = std::move(message)]() mutable {
+        self->sendInLoop(std::move(message));
+      });
     }
   }
 }
 
-// FIXME efficiency!!!
 void TcpConnection::send(Buffer* message) {
-  if (state_ == kConnected) {
+  if (state() == kConnected) {
     if (loop_->IsInLoopThread()) {
       sendInLoop(message->peek(), message->readableBytes());
       message->retrieveAll();
     } else {
-      void (TcpConnection::*fp)(const std::string_view& message) =
-          &TcpConnection::sendInLoop;
-      loop_->RunInLoop(absl::bind_front(fp,
-                                        this,  // FIXME
-                                        message->retrieveAllAsString()));
-      // std::forward<std::string>(message)));
+      Buffer swapped(0);
+      swapped.swap(*message);
+      send(std::move(swapped));
+    }
+  }
+}
+
+void TcpConnection::send(Buffer&& message) {
+  if (state() == kConnected) {
+    if (loop_->IsInLoopThread()) {
+      sendInLoop(std::move(message));
+    } else {
+      loop_->RunInLoop([self = shared_from_this(),
+                        message = std::move(message)]() mutable {
+        self->sendInLoop(std::move(message));
+      });
+    }
+  }
+}
+
+void TcpConnection::send(std::shared_ptr<const Bytes> message) {
+  send(Slice(std::move(message)));
+}
+
+void TcpConnection::send(Slice message) {
+  if (state() == kConnected) {
+    if (loop_->IsInLoopThread()) {
+      sendInLoop(std::move(message));
+    } else {
+      loop_->RunInLoop([self = shared_from_this(),
+                        message = std::move(message)]() mutable {
+        self->sendInLoop(std::move(message));
+      });
+    }
+  }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length) {
+  if (state() == kConnected) {
+    int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dupfd < 0) {
+      PLOG(ERROR) << "TcpConnection::sendFile";
+      return;
+    }
+    if (loop_->IsInLoopThread()) {
+      sendFileInLoop(dupfd, offset, length);
+    } else {
+      loop_->RunInLoop([self = shared_from_this(), dupfd, offset, length] {
+        self->sendFileInLoop(dupfd, offset, length);
+      });
     }
   }
 }
@@ -136,62 +227,210 @@ void TcpConnection::sendInLoop(const std::string_view& message) {
 }
 
 void TcpConnection::sendInLoop(const void* message, size_t len) {
+  size_t nwrote = 0;
+  if (writeInLoop(message, len, &nwrote) && nwrote < len) {
+    size_t oldLen = outputBuffer_.readableBytes();
+    outputBuffer_.append(static_cast<const char*>(message) + nwrote,
+                         len - nwrote);
+    handleOutputQueued(oldLen);
+  }
+}
+
+void TcpConnection::sendInLoop(std::string&& message) {
+  if (isZeroCopyable(message.size())) {
+    sendInLoop(Slice::fromString(std::move(message)));
+    return;
+  }
+  size_t nwrote = 0;
+  if (writeInLoop(message.data(), message.size(), &nwrote) &&
+      nwrote < message.size()) {
+    Slice slice = Slice::fromString(std::move(message));
+    slice.removePrefix(nwrote);
+    sendInLoop(std::move(slice));
+  }
+}
+
+void TcpConnection::sendInLoop(Buffer&& message) {
+  if (isZeroCopyable(message.readableBytes())) {
+    sendInLoop(Slice::fromBuffer(std::move(message)));
+    return;
+  }
+  size_t nwrote = 0;
+  if (writeInLoop(message.peek(), message.readableBytes(), &nwrote) &&
+      nwrote < message.readableBytes()) {
+    message.retrieve(nwrote);
+    sendInLoop(Slice::fromBuffer(std::move(message)));
+  }
+}
+
+void TcpConnection::sendInLoop(Slice&& message) {
   loop_->AssertInLoopThread();
-  ssize_t nwrote = 0;
-  size_t remaining = len;
-  bool faultError = false;
-  if (state_ == kDisconnected) {
+  // Checked up front, the output queue may short-circuit writeInLoop below.
+  if (state() == kDisconnected) {
     LOG(WARNING) << "disconnected, give up writing";
     return;
   }
+  if (isZeroCopyable(message.size())) {
+    // Queued to be held until the completion, then sent from the queue.
+    size_t oldLen = outputBuffer_.readableBytes();
+    outputBuffer_.append(std::move(message));
+    writeAppendedInLoop(oldLen);
+    return;
+  }
+  size_t nwrote = 0;
+  if (outputBuffer_.readableBytes() != 0 ||
+      (writeInLoop(message.data(), message.size(), &nwrote) &&
+       nwrote < message.size())) {
+    message.removePrefix(nwrote);
+    size_t oldLen = outputBuffer_.readableBytes();
+    outputBuffer_.append(std::move(message));
+    handleOutputQueued(oldLen);
+  }
+}
+
+bool TcpConnection::writeInLoop(const void* message, size_t len,
+                                size_t* nwrote) {
+  loop_->AssertInLoopThread();
+  *nwrote = 0;
+  if (state() == kDisconnected) {
+    LOG(WARNING) << "disconnected, give up writing";
+    return false;
+  }
   // if no thing in output queue, try writing directly
-  if (!channel_->IsWritingEnabled() && outputBuffer_.readableBytes() == 0) {
-    nwrote = sockets::write(channel_->fd(), message, len);
-    if (nwrote >= 0) {
-      remaining = len - nwrote;
-      if (remaining == 0 && writeCompleteCallback_) {
+  if (!cork_ && !channel_->IsWritingEnabled() &&
+      outputBuffer_.readableBytes() == 0) {
+    ssize_t n = sockets::write(channel_->fd(), message, len);
+    countWrite(n, n >= 0 ? absl::implicit_cast<size_t>(n) < len
+                         : errno == EWOULDBLOCK);
+    if (n >= 0) {
+      *nwrote = n;
+      if (*nwrote == len && writeCompleteCallback_) {
         loop_->QueueInLoop(
             absl::bind_front(writeCompleteCallback_, shared_from_this()));
       }
-    } else {  // nwrote < 0
-      nwrote = 0;
+    } else {  // n < 0
       if (errno != EWOULDBLOCK) {
         LOG(ERROR) << "TcpConnection::sendInLoop";
         if (errno == EPIPE || errno == ECONNRESET) {  // FIXME: any others?
-          faultError = true;
+          return false;
         }
       }
     }
   }
+  assert(*nwrote <= len);
+  return true;
+}
 
-  assert(remaining <= len);
-  if (!faultError && remaining > 0) {
-    size_t oldLen = outputBuffer_.readableBytes();
-    if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ &&
-        highWaterMarkCallback_) {
-      loop_->QueueInLoop(absl::bind_front(
-          highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+void TcpConnection::handleOutputQueued(size_t oldLen) {
+  size_t newLen = outputBuffer_.readableBytes();
+  if (newLen >= highWaterMark_ && oldLen < highWaterMark_ &&
+      highWaterMarkCallback_) {
+    loop_->QueueInLoop(
+        absl::bind_front(highWaterMarkCallback_, shared_from_this(), newLen));
+  }
+  maxQueuedBytes_.store(
+      std::max<int64_t>(maxQueuedBytes_.load(std::memory_order_relaxed),
+                        static_cast<int64_t>(newLen)),
+      std::memory_order_relaxed);
+  if (!channel_->IsWritingEnabled()) {
+    if (!cork_) {
+      waitWritable();
+    } else if (!flushScheduled_) {
+      flushScheduled_ = true;
+      loop_->RunAtIterationEnd(
+          [self = shared_from_this()] { self->flushCorked(); });
+    }
+  }
+  updateBackpressure();
+}
+
+void TcpConnection::flushCorked() {
+  flushScheduled_ = false;
+  // Left to handleWrite, or closed.
+  if (channel_->IsWritingEnabled() || waitingForPipe() ||
+      state() == kDisconnected || outputBuffer_.readableBytes() == 0) {
+    return;
+  }
+  int savedErrno = 0;
+  ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+  countWrite(n, outputBuffer_.readableBytes() > 0);
+  if (n < 0 && savedErrno != EWOULDBLOCK) {
+    errno = savedErrno;
+    PLOG(ERROR) << "TcpConnection::flushCorked";
+    if (savedErrno == EPIPE || savedErrno == ECONNRESET) {
+      outputBuffer_.retrieveAll();
+      updateBackpressure();
+      return;
+    }
+  }
+  if (outputBuffer_.readableBytes() == 0) {
+    if (writeCompleteCallback_) {
+      loop_->QueueInLoop(
+          absl::bind_front(writeCompleteCallback_, shared_from_this()));
+    }
+    if (state() == kDisconnecting) {
+      shutdownInLoop();
+    }
+  } else {
+    // The rest is left to handleWrite.
+    waitWritable();
+  }
+  updateBackpressure();
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length) {
+  loop_->AssertInLoopThread();
+  if (state() == kDisconnected) {
+    LOG(WARNING) << "disconnected, give up writing";
+    ::close(fd);
+    return;
+  }
+  size_t oldLen = outputBuffer_.readableBytes();
+  outputBuffer_.appendFile(fd, offset, length);
+  writeAppendedInLoop(oldLen);
+}
+
+void TcpConnection::writeAppendedInLoop(size_t oldLen) {
+  // if no thing in output queue, try writing directly
+  if (!cork_ && !channel_->IsWritingEnabled() && oldLen == 0) {
+    int savedErrno = 0;
+    ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+    countWrite(n, outputBuffer_.readableBytes() > 0);
+    if (n < 0 && savedErrno != EWOULDBLOCK) {
+      errno = savedErrno;
+      PLOG(ERROR) << "TcpConnection::writeAppendedInLoop";
+      if (savedErrno == EPIPE || savedErrno == ECONNRESET) {
+        outputBuffer_.retrieveAll();
+        return;
+      }
     }
-    outputBuffer_.append(static_cast<const char*>(message) + nwrote, remaining);
-    if (!channel_->IsWritingEnabled()) {
-      channel_->EnableWriting();
+    if (outputBuffer_.readableBytes() == 0) {
+      if (writeCompleteCallback_) {
+        loop_->QueueInLoop(
+            absl::bind_front(writeCompleteCallback_, shared_from_this()));
+      }
+      return;
     }
   }
+  handleOutputQueued(oldLen);
 }
 
 void TcpConnection::shutdown() {
-  // FIXME: use compare and swap
-  if (state_ == kConnected) {
-    setState(kDisconnecting);
-    // FIXME: shared_from_this()?
-    loop_->RunInLoop(absl::bind_front(&TcpConnection::shutdownInLoop, this));
+  // Only the winner of racing callers shuts down.
+  if (transitState(kConnected, kDisconnecting)) {
+    loop_->RunInLoop(
+        absl::bind_front(&TcpConnection::shutdownInLoop, shared_from_this()));
   }
 }
 
 void TcpConnection::shutdownInLoop() {
   loop_->AssertInLoopThread();
-  if (!channel_->IsWritingEnabled()) {
-    // we are not writing
+  // Closed meanwhile.
+  if (state() != kDisconnecting) {
+    return;
+  }
+  if (!channel_->IsWritingEnabled() && outputBuffer_.readableBytes() == 0) {
+    // we are not writing, nor holding corked messages
     socket_->shutdownWrite();
   }
 }
@@ -221,18 +460,26 @@ void TcpConnection::shutdownInLoop() {
 //                        &TcpConnection::forceCloseInLoop));
 // }
 
+bool TcpConnection::startDisconnecting() {
+  StateE state = state_.load(std::memory_order_acquire);
+  while (state == kConnected || state == kDisconnecting) {
+    if (state_.compare_exchange_weak(state, kDisconnecting,
+                                     std::memory_order_acq_rel)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void TcpConnection::forceClose() {
-  // FIXME: use compare and swap
-  if (state_ == kConnected || state_ == kDisconnecting) {
-    setState(kDisconnecting);
+  if (startDisconnecting()) {
     loop_->QueueInLoop(
         absl::bind_front(&TcpConnection::forceCloseInLoop, shared_from_this()));
   }
 }
 
 void TcpConnection::forceCloseWithDelay(absl::Duration duration) {
-  if (state_ == kConnected || state_ == kDisconnecting) {
-    setState(kDisconnecting);
+  if (startDisconnecting()) {
     loop_->RunAfter(duration, [weak_this = weak_from_this()] {
       auto shared_this = weak_this.lock();
       if (shared_this) {
@@ -245,14 +492,15 @@ void TcpConnection::forceCloseWithDelay(absl::Duration duration) {
 
 void TcpConnection::forceCloseInLoop() {
   loop_->AssertInLoopThread();
-  if (state_ == kConnected || state_ == kDisconnecting) {
+  const StateE state = this->state();
+  if (state == kConnected || state == kDisconnecting) {
     // as if we received 0 byte in handleRead();
     handleClose();
   }
 }
 
 const char* TcpConnection::stateToString() const {
-  switch (state_) {
+  switch (state()) {
     case kDisconnected:
       return "kDisconnected";
     case kConnecting:
@@ -268,15 +516,35 @@ const char* TcpConnection::stateToString() const {
 
 void TcpConnection::setTcpNoDelay(bool on) { socket_->setTcpNoDelay(on); }
 
+void TcpConnection::setBusyPoll(int usec) { socket_->setBusyPoll(usec); }
+
+bool TcpConnection::setZeroCopy(size_t threshold) {
+  if (!socket_->setZeroCopy(threshold != 0)) {
+    return false;
+  }
+  outputBuffer_.setZeroCopyThreshold(threshold);
+  return true;
+}
+
+bool TcpConnection::setEdgeTriggered(bool on) {
+  return channel_->SetEdgeTriggered(on);
+}
+
+void TcpConnection::setIdleTimeouts(std::shared_ptr<IdleTimeouts> timeouts) {
+  idleEntry_ = std::make_unique<IdleTimeoutEntry>();
+  idleEntry_->conn = this;
+  idleEntry_->owner = std::move(timeouts);
+}
+
 void TcpConnection::startRead() {
   loop_->RunInLoop(absl::bind_front(&TcpConnection::startReadInLoop, this));
 }
 
 void TcpConnection::startReadInLoop() {
   loop_->AssertInLoopThread();
-  if (!reading_ || !channel_->IsReadingEnabled()) {
+  reading_ = true;
+  if (readPauses_ == 0 && !channel_->IsReadingEnabled()) {
     channel_->EnableReading();
-    reading_ = true;
   }
 }
 
@@ -292,34 +560,169 @@ void TcpConnection::stopReadInLoop() {
   }
 }
 
+void TcpConnection::pauseReadInLoop(bool pause) {
+  loop_->AssertInLoopThread();
+  readPauses_ += pause ? 1 : -1;
+  assert(readPauses_ >= 0);
+  const StateE state = this->state();
+  if (state != kConnected && state != kDisconnecting) {
+    return;
+  }
+  if (pause && readPauses_ == 1 && channel_->IsReadingEnabled()) {
+    channel_->DisableReading();
+  } else if (!pause && readPauses_ == 0 && reading_ &&
+             !channel_->IsReadingEnabled()) {
+    channel_->EnableReading();
+  }
+}
+
+void TcpConnection::setBackpressure(
+    const std::shared_ptr<TcpConnection>& upstream, size_t highWaterMark,
+    size_t lowWaterMark) {
+  loop_->AssertInLoopThread();
+  assert(lowWaterMark < highWaterMark);
+  releaseUpstream();
+  upstream_ = upstream;
+  backpressureHighMark_ = highWaterMark;
+  backpressureLowMark_ = lowWaterMark;
+  updateBackpressure();
+}
+
+void TcpConnection::updateBackpressureSlow() {
+  const size_t queued = outputBuffer_.readableBytes();
+  if (!upstreamPaused_ && queued >= backpressureHighMark_) {
+    setUpstreamPaused(true);
+  } else if (upstreamPaused_ && queued <= backpressureLowMark_) {
+    setUpstreamPaused(false);
+  }
+}
+
+void TcpConnection::setUpstreamPaused(bool paused) {
+  upstreamPaused_ = paused;
+  if (std::shared_ptr<TcpConnection> upstream = upstream_.lock()) {
+    upstream->loop_->RunInLoop(
+        [upstream, paused] { upstream->pauseReadInLoop(paused); });
+  }
+}
+
+void TcpConnection::releaseUpstream() {
+  if (upstreamPaused_) {
+    setUpstreamPaused(false);
+  }
+  upstream_.reset();
+  backpressureHighMark_ = 0;
+}
+
 void TcpConnection::connectEstablished() {
   loop_->AssertInLoopThread();
-  assert(state_ == kConnecting);
-  setState(kConnected);
+  const bool established = transitState(kConnecting, kConnected);
+  assert(established);
+  (void)established;
   channel_->Tie(shared_from_this());
-  channel_->EnableReading();
+  if (readPauses_ == 0) {
+    channel_->EnableReading();
+  }
+  loop_->UpdateNumConnections(1);
+  if (idleEntry_) {
+    idleEntry_->owner->Add(idleEntry_.get(), absl::Now());
+  }
 
   connectionCallback_(shared_from_this());
 }
 
 void TcpConnection::connectDestroyed() {
   loop_->AssertInLoopThread();
-  if (state_ == kConnected) {
-    setState(kDisconnected);
+  if (transitState(kConnected, kDisconnected)) {
     channel_->DisableAll();
 
     connectionCallback_(shared_from_this());
   }
+  releaseUpstream();
+  if (idleEntry_) {
+    idleEntry_->owner->Remove(idleEntry_.get());
+  }
+  // Counted only if it was established.
+  if (state() != kConnecting) {
+    loop_->UpdateNumConnections(-1);
+  }
   channel_->RemoveFromOwnerEventLoop();
+  stopWaitingForPipe();
+  // Give the memory back in loop thread, the last reference of this
+  // connection may be dropped in any thread.
+  inputBuffer_.retrieveAll();
+  recycleInputBuffer();
+  outputBuffer_.retrieveAll();
+  // The last chance to read the completions, e.g. of the sends acknowledged
+  // before the peer closed.
+  if (outputBuffer_.numZeroCopyPending() > 0) {
+    handleZeroCopyCompletions();
+  }
+  if (outputBuffer_.numZeroCopyPending() > 0) {
+    VLOG(1) << "TcpConnection::connectDestroyed [" << name_ << "] - "
+            << outputBuffer_.numZeroCopyPending()
+            << " zero-copy sends not completed";
+  }
 }
 
 void TcpConnection::handleRead(absl::Time receiveTime) {
   loop_->AssertInLoopThread();
+  if (inputBuffer_.internalCapacity() == 0) {
+    allocateInputBuffer(&inputBuffer_, readSize_);
+  }
   int savedErrno = 0;
-  ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-  if (n > 0) {
+  ssize_t n = 0;
+  size_t total = 0;
+  bool drained = false;
+  for (;;) {
+    // Read into the free space of inputBuffer_ & the loop scratch, up to
+    // readSize_ bytes, so there is no 64KiB extra buffer per read.
+    const size_t writable = inputBuffer_.writableBytes();
+    const size_t extrasize =
+        readSize_ > writable
+            ? std::min(readSize_ - writable, EventLoop::kReadScratchSize)
+            : 0;
+    n = inputBuffer_.readFd(channel_->fd(), loop_->read_scratch(), extrasize,
+                            &savedErrno);
+    countRead(n);
+    if (n <= 0) {
+      drained = n < 0 && savedErrno == EAGAIN;
+      break;
+    }
+    total += n;
+    adaptReadSize(n);
+    // A short read means the socket is drained, no need to wait for EAGAIN.
+    // Not in edge-triggered mode, where a FIN arriving along with the data
+    // raises no other edge, so it reads on until EAGAIN or EOF.
+    if (!channel_->IsEdgeTriggered() &&
+        absl::implicit_cast<size_t>(n) < writable + extrasize) {
+      drained = true;
+      break;
+    }
+    if (total >= readBudget_) {
+      break;
+    }
+  }
+  if (total > 0) {
+    lastReadNanos_.store(absl::ToUnixNanos(receiveTime),
+                         std::memory_order_relaxed);
+    if (idleEntry_) {
+      idleEntry_->owner->Touch(idleEntry_.get(), ConnectionTimeout::kReadIdle,
+                               receiveTime);
+    }
+    // EOF or error after some data is handled on the next readable event, or
+    // the next read queued below in edge-triggered mode.
     messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    recycleInputBuffer();
+    // There won't be another edge for the bytes left.
+    if (!drained && channel_->IsEdgeTriggered()) {
+      continueReading(receiveTime);
+    }
+  } else if (drained) {
+    // Spurious wakeup, e.g. an edge-triggered event for the bytes drained by
+    // an earlier read.
+    recycleInputBuffer();
   } else if (n == 0) {
+    recycleInputBuffer();
     handleClose();
   } else {
     errno = savedErrno;
@@ -328,29 +731,214 @@ void TcpConnection::handleRead(absl::Time receiveTime) {
   }
 }
 
+void TcpConnection::recycleInputBuffer() {
+  if (inputBuffer_.readableBytes() == 0) {
+    if (inputBuffer_.internalCapacity() > 0) {
+      std::vector<char> storage = inputBuffer_.releaseStorage();
+      if (inputBlockSize_ != 0) {
+        loop_->buffer_pool()->Deallocate(std::move(storage), inputBlockSize_);
+        inputBlockSize_ = 0;
+      }
+    }
+  } else if (inputBuffer_.internalCapacity() > kShrinkCapacity &&
+             inputBuffer_.readableBytes() * 4 < kShrinkCapacity) {
+    // A burst has been consumed, don't keep the large storage for the partial
+    // message left, move it into a pooled block.
+    Buffer shrunk(0);
+    const size_t oldBlockSize = inputBlockSize_;
+    allocateInputBuffer(&shrunk, inputBuffer_.readableBytes() +
+                                     Buffer::kCheapPrepend);
+    shrunk.append(inputBuffer_.peek(), inputBuffer_.readableBytes());
+    inputBuffer_.retrieveAll();
+    std::vector<char> storage = inputBuffer_.releaseStorage();
+    if (oldBlockSize != 0) {
+      loop_->buffer_pool()->Deallocate(std::move(storage), oldBlockSize);
+    }
+    inputBuffer_.swap(shrunk);
+  }
+}
+
+void TcpConnection::allocateInputBuffer(Buffer* buffer, size_t size) {
+  inputBlockSize_ = std::min(size, BufferPool::kMaxBlockSize);
+  buffer->adoptStorage(loop_->buffer_pool()->Allocate(inputBlockSize_));
+}
+
+void TcpConnection::adaptReadSize(size_t lastRead) {
+  static const size_t kMaxReadSize = EventLoop::kReadScratchSize;
+  if (lastRead >= readSize_) {
+    readSize_ = std::min(readSize_ * 2, kMaxReadSize);
+    smallReads_ = 0;
+  } else if (lastRead <= readSize_ / 2) {
+    // Shrink slowly, a single small read may be the tail of a burst.
+    if (++smallReads_ >= 2) {
+      readSize_ = std::max(readSize_ / 2, kMinReadSize);
+      smallReads_ = 0;
+    }
+  } else {
+    smallReads_ = 0;
+  }
+}
+
+ConnectionStats TcpConnection::stats() const {
+  ConnectionStats stats;
+  stats.bytes_received = bytesReceived_.load(std::memory_order_relaxed);
+  stats.bytes_sent = bytesSent_.load(std::memory_order_relaxed);
+  stats.reads = reads_.load(std::memory_order_relaxed);
+  stats.writes = writes_.load(std::memory_order_relaxed);
+  stats.partial_writes = partialWrites_.load(std::memory_order_relaxed);
+  stats.max_queued_bytes = maxQueuedBytes_.load(std::memory_order_relaxed);
+  stats.write_blocked_time =
+      absl::Nanoseconds(writeBlockedNanos_.load(std::memory_order_relaxed));
+  stats.creation_time = creationTime_;
+  stats.last_read_time =
+      absl::FromUnixNanos(lastReadNanos_.load(std::memory_order_relaxed));
+  stats.last_write_time =
+      absl::FromUnixNanos(lastWriteNanos_.load(std::memory_order_relaxed));
+  return stats;
+}
+
+absl::Time TcpConnection::iterationTime() const {
+  // Or the creation time, if the loop isn't looping yet.
+  return std::max(loop_->mutable_stats()->poll_return_time, creationTime_);
+}
+
+void TcpConnection::countRead(ssize_t n) {
+  EventLoopStats* loopStats = loop_->mutable_stats();
+  addRelaxed(&reads_, 1);
+  ++loopStats->reads;
+  if (n > 0) {
+    addRelaxed(&bytesReceived_, n);
+    loopStats->bytes_received += n;
+  }
+}
+
+void TcpConnection::countWrite(ssize_t n, bool partial) {
+  EventLoopStats* loopStats = loop_->mutable_stats();
+  addRelaxed(&writes_, 1);
+  ++loopStats->writes;
+  if (n > 0) {
+    addRelaxed(&bytesSent_, n);
+    loopStats->bytes_sent += n;
+    lastWriteNanos_.store(absl::ToUnixNanos(iterationTime()),
+                          std::memory_order_relaxed);
+    touchWrite();
+  }
+  if (partial) {
+    addRelaxed(&partialWrites_, 1);
+    ++loopStats->partial_writes;
+  }
+}
+
+void TcpConnection::waitWritable() {
+  if (waitingForPipe()) {
+    return;
+  }
+  writeBlockedSince_ = iterationTime();
+  if (!waitForPipe()) {
+    channel_->EnableWriting();
+  }
+}
+
+bool TcpConnection::waitForPipe() {
+  const int pipe = outputBuffer_.emptyPipe();
+  if (pipe < 0) {
+    return false;
+  }
+  assert(!waitingForPipe());
+  if (channel_->IsWritingEnabled()) {
+    channel_->DisableWriting();
+  }
+  // The previous one has been removed, and isn't handling events.
+  pipeChannel_ = std::make_unique<Channel>(loop_, pipe);
+  pipeChannel_->Tie(shared_from_this());
+  pipeChannel_->DisableLogHup();
+  pipeChannel_->SetReadCallback([this](absl::Time) { handlePipeReadable(); });
+  pipeChannel_->SetCloseCallback([this] { handlePipeReadable(); });
+  pipeChannel_->SetErrorCallback([this] { handlePipeReadable(); });
+  pipeChannel_->EnableReading();
+  return true;
+}
+
+bool TcpConnection::waitingForPipe() const {
+  return pipeChannel_ && !pipeChannel_->IsNoneEvent();
+}
+
+void TcpConnection::handlePipeReadable() {
+  loop_->AssertInLoopThread();
+  // Several callbacks of the same event.
+  if (!waitingForPipe()) {
+    return;
+  }
+  stopWaitingForPipe();
+  channel_->EnableWriting();
+  if (channel_->IsEdgeTriggered()) {
+    // No edge comes for a socket writable all along. Not written here, the
+    // pipe channel may be replaced while handling its own event.
+    loop_->QueueInLoop([self = shared_from_this()] { self->handleWrite(); });
+  }
+}
+
+void TcpConnection::stopWaitingForPipe() {
+  if (waitingForPipe()) {
+    pipeChannel_->DisableAll();
+    pipeChannel_->RemoveFromOwnerEventLoop();
+  }
+}
+
+void TcpConnection::touchWrite() {
+  if (idleEntry_ &&
+      idleEntry_->owner->enabled(ConnectionTimeout::kWriteIdle)) {
+    idleEntry_->owner->Touch(idleEntry_.get(), ConnectionTimeout::kWriteIdle,
+                             iterationTime());
+  }
+}
+
+void TcpConnection::continueReading(absl::Time receiveTime) {
+  loop_->QueueInLoop([self = shared_from_this(), receiveTime] {
+    const StateE state = self->state();
+    if ((state == kConnected || state == kDisconnecting) &&
+        self->channel_->IsReadingEnabled()) {
+      self->handleRead(receiveTime);
+    }
+  });
+}
+
 void TcpConnection::handleWrite() {
   loop_->AssertInLoopThread();
   if (channel_->IsWritingEnabled()) {
-    ssize_t n = sockets::write(channel_->fd(), outputBuffer_.peek(),
-                               outputBuffer_.readableBytes());
+    int savedErrno = 0;
+    ssize_t n = 0;
+    bool more = false;
+    // There won't be another edge until the socket buffer fills up.
+    do {
+      n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+      more = n > 0 && outputBuffer_.readableBytes() > 0 &&
+             channel_->IsEdgeTriggered();
+      countWrite(n, !more && outputBuffer_.readableBytes() > 0);
+    } while (more);
     if (n > 0) {
-      outputBuffer_.retrieve(n);
-      if (outputBuffer_.readableBytes() == 0) {
-        channel_->DisableWriting();
-        if (writeCompleteCallback_) {
-          loop_->QueueInLoop(
-              absl::bind_front(writeCompleteCallback_, shared_from_this()));
-        }
-        if (state_ == kDisconnecting) {
-          shutdownInLoop();
-        }
+      updateBackpressure();
+    }
+    if (n < 0 && savedErrno == EAGAIN) {
+      // Either the socket is full, or the pipe at the front is empty.
+      waitForPipe();
+    } else if (n <= 0) {
+      errno = savedErrno;
+      PLOG(ERROR) << "TcpConnection::handleWrite";
+    }
+    // A truncated file region is dropped even though nothing was written.
+    if (outputBuffer_.readableBytes() == 0) {
+      channel_->DisableWriting();
+      const absl::Duration blocked = iterationTime() - writeBlockedSince_;
+      addRelaxed(&writeBlockedNanos_, absl::ToInt64Nanoseconds(blocked));
+      loop_->mutable_stats()->write_blocked_time += blocked;
+      if (writeCompleteCallback_) {
+        loop_->QueueInLoop(
+            absl::bind_front(writeCompleteCallback_, shared_from_this()));
+      }
+      if (state() == kDisconnecting) {
+        shutdownInLoop();
       }
-    } else {
-      LOG(ERROR) << "TcpConnection::handleWrite";
-      // if (state_ == kDisconnecting)
-      // {
-      //   shutdownInLoop();
-      // }
     }
   } else {
     VLOG(1) << "Connection fd = " << channel_->fd()
@@ -361,10 +949,15 @@ void TcpConnection::handleWrite() {
 void TcpConnection::handleClose() {
   loop_->AssertInLoopThread();
   VLOG(1) << "fd = " << channel_->fd() << " state = " << stateToString();
-  assert(state_ == kConnected || state_ == kDisconnecting);
+  assert(state() == kConnected || state() == kDisconnecting);
   // we don't close fd, leave it to dtor, so we can find leaks easily.
   setState(kDisconnected);
   channel_->DisableAll();
+  stopWaitingForPipe();
+  releaseUpstream();
+  if (idleEntry_) {
+    idleEntry_->owner->Remove(idleEntry_.get());
+  }
 
   std::shared_ptr<TcpConnection> guardThis(shared_from_this());
   connectionCallback_(guardThis);
@@ -372,8 +965,31 @@ void TcpConnection::handleClose() {
   closeCallback_(guardThis);
 }
 
+bool TcpConnection::handleZeroCopyCompletions() {
+  uint32_t lo = 0;
+  uint32_t hi = 0;
+  bool copied = false;
+  bool completed = false;
+  while (sockets::recvZeroCopyCompletion(channel_->fd(), &lo, &hi, &copied)) {
+    completed = true;
+    outputBuffer_.releaseZeroCopied(lo, hi);
+    if (copied && outputBuffer_.zeroCopyThreshold() != 0) {
+      VLOG(1) << "TcpConnection::handleZeroCopyCompletions [" << name_
+              << "] - copied by the kernel, fall back to copying";
+      outputBuffer_.setZeroCopyThreshold(0);
+    }
+  }
+  return completed;
+}
+
 void TcpConnection::handleError() {
+  // The zero-copy completions are reported as errors.
+  const bool completed = outputBuffer_.numZeroCopyPending() != 0 &&
+                         handleZeroCopyCompletions();
   int err = sockets::getSocketError(channel_->fd());
+  if (completed && err == 0) {
+    return;
+  }
   LOG(ERROR) << "TcpConnection::handleError [" << name_
              << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
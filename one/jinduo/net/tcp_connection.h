@@ -27,7 +27,11 @@
 
 #pragma once
 
+#include <sys/types.h>
+
 #include <any>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -36,7 +40,10 @@
 #include "absl/time/time.h"
 #include "one/jinduo/net/buffer.h"
 #include "one/jinduo/net/callbacks.h"
+#include "one/jinduo/net/chain_buffer.h"
+#include "one/jinduo/net/connection_stats.h"
 #include "one/jinduo/net/inet_address.h"
+#include "one/jinduo/net/slice.h"
 
 // struct tcp_info is in <netinet/tcp.h>
 struct tcp_info;
@@ -46,7 +53,9 @@ namespace net {
 
 class Channel;
 class EventLoop;
+class IdleTimeouts;
 class Socket;
+struct IdleTimeoutEntry;
 
 ///
 /// TCP connection, for both client and server usage.
@@ -58,7 +67,8 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   ///
   /// User should not create this object.
   TcpConnection(EventLoop* loop, std::string name, int sockfd,
-                const InetAddress& localAddr, const InetAddress& peerAddr);
+                const InetAddress& localAddr, const InetAddress& peerAddr,
+                ConnectionId id = 0);
   ~TcpConnection();
 
   // Disallow copy.
@@ -71,24 +81,49 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 
   EventLoop* getLoop() const { return loop_; }
   const std::string& name() const { return name_; }
+  /// Assigned by the TcpServer or TcpClient, see @c TcpServer::getConnection.
+  ConnectionId id() const { return id_; }
   const InetAddress& localAddress() const { return localAddr_; }
   const InetAddress& peerAddress() const { return peerAddr_; }
-  bool connected() const { return state_ == kConnected; }
-  bool disconnected() const { return state_ == kDisconnected; }
+  absl::Time creationTime() const { return creationTime_; }
+  // When the last message is received, or the creation time if none.
+  absl::Time lastReceiveTime() const {
+    return absl::FromUnixNanos(lastReadNanos_.load(std::memory_order_relaxed));
+  }
+  /// Traffic counters, always on. Lock-free & safe to call from any thread,
+  /// though the counters are loaded one by one, not as a consistent snapshot.
+  /// See @c EventLoopStats for the sums of a loop.
+  ConnectionStats stats() const;
+  bool connected() const { return state() == kConnected; }
+  bool disconnected() const { return state() == kDisconnected; }
   // return true if success.
   bool getTcpInfo(struct tcp_info*) const;
   std::string getTcpInfoString() const;
 
-  // void send(std::string&& message); // C++11
   void send(const void* message, int len);
   void send(const std::string_view& message);
+  void send(const char* message) { send(std::string_view(message)); }
   void send(Buffer* message);  // this one will swap data
+  // The overloads below take the ownership of the payload, no copying even if
+  // it's called from other threads. Sharing a `Bytes` or `Slice` among many
+  // connections costs no extra allocation of the payload.
+  void send(std::string&& message);
+  void send(Buffer&& message);
+  void send(std::shared_ptr<const Bytes> message);
+  void send(Slice message);
+  // Sends a region of the file with sendfile(2), or splice(2) if fd is a pipe,
+  // in order with the data sent before & after. The fd is duplicated, so the
+  // caller could close it at once. Writing waits for an empty pipe to be
+  // readable, a pipe closed before the region is filled truncates it.
+  void sendFile(int fd, off_t offset, size_t length);
   void shutdown();             // NOT thread safe, no simultaneous calling
   // void shutdownAndForceCloseAfter(double seconds); // NOT thread safe, no
   // simultaneous calling
   void forceClose();
   void forceCloseWithDelay(absl::Duration duration);
   void setTcpNoDelay(bool on);
+  // SO_BUSY_POLL in microseconds, 0 to disable.
+  void setBusyPoll(int usec);
   // reading or not
   void startRead();
   void stopRead();
@@ -120,14 +155,73 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
     highWaterMark_ = highWaterMark;
   }
 
+  /// Flow control for a proxy, where the messages read from @c upstream are
+  /// sent through this connection.
+  ///
+  /// Reading of @c upstream pauses once the output queue of this connection
+  /// grows up to @c highWaterMark, and resumes once it drains down to
+  /// @c lowWaterMark, so a slow peer bounds the memory instead of the queue
+  /// growing without limit. An upstream linked to many connections reads only
+  /// if none of them is above its high-water mark. It's resumed when this
+  /// connection closes.
+  /// @code
+  /// // Both directions of a proxy.
+  /// client->setBackpressure(backend, 4 << 20, 1 << 20);
+  /// backend->setBackpressure(client, 4 << 20, 1 << 20);
+  /// @endcode
+  /// Call it in the loop thread, the upstream may live in another loop.
+  void setBackpressure(const std::shared_ptr<TcpConnection>& upstream,
+                       size_t highWaterMark, size_t lowWaterMark);
+
+  /// Reads repeatedly on a readable event until the socket is drained or
+  /// @c budget bytes are read, before calling the message callback once.
+  /// 0 means a single read per event, which is the default.
+  void setReadBudget(size_t budget) { readBudget_ = budget; }
+
+  /// Polls the socket edge-triggered, it's drained until EAGAIN on each event
+  /// & the write event is never toggled in the poller. A read stopped by the
+  /// budget goes on in a queued functor instead of the next event.
+  /// Returns false if the poller doesn't support it.
+  /// Call it before the connection is established, or in the loop thread.
+  bool setEdgeTriggered(bool on);
+
+  /// Corks the connection in user space, the messages sent in an iteration of
+  /// the loop are queued & flushed together with a single writev(2) at the
+  /// end of it, instead of a write(2) per send. It trades a little latency for
+  /// fewer syscalls & packets, for a connection sending many small messages,
+  /// e.g. pipelined responses. It's unrelated to TCP_CORK.
+  /// Call it before the connection is established, or in the loop thread.
+  void setCork(bool on) { cork_ = on; }
+
+  /// Sends the payloads of at least @c threshold bytes with MSG_ZEROCOPY, 0 to
+  /// disable. It saves copying the payload into the socket buffer, at the
+  /// cost of pinning its pages & a completion per send, which pays off for
+  /// payloads of hundreds of KB or more. Only the payloads handed over, i.e.
+  /// a moved string or buffer, or a @c Slice, qualify, as they're held until
+  /// the kernel reports it's done with them. The smaller ones are copied as
+  /// usual, still coalescing under Nagle's algorithm unless TCP_NODELAY is
+  /// set. It falls back to copying once the kernel reports it copied anyway,
+  /// e.g. over loopback.
+  /// The completions can't be read once the fd is closed, so the payloads
+  /// still pending when the connection is destroyed are released anyway, and
+  /// a retransmission may send whatever reuses their memory. Shut down &
+  /// wait for the peer to close, which acknowledges all the data, before
+  /// dropping a connection whose tail matters.
+  /// Returns false if the socket doesn't support it.
+  /// Call it before the connection is established, or in the loop thread.
+  bool setZeroCopy(size_t threshold);
+
   /// Advanced interface
   Buffer* inputBuffer() { return &inputBuffer_; }
 
-  Buffer* outputBuffer() { return &outputBuffer_; }
+  ChainBuffer* outputBuffer() { return &outputBuffer_; }
 
   /// Internal use only.
   void setCloseCallback(const CloseCallback& cb) { closeCallback_ = cb; }
 
+  /// Internal use only, tracks the connection from @c connectEstablished on.
+  void setIdleTimeouts(std::shared_ptr<IdleTimeouts> timeouts);
+
   // called when TcpServer accepts a new connection
   void connectEstablished();  // should be called only once
   // called when TcpServer has removed me from its map
@@ -136,23 +230,88 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
  private:
   enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
   void handleRead(absl::Time receiveTime);
+  void continueReading(absl::Time receiveTime);
   void handleWrite();
   void handleClose();
   void handleError();
-  // void sendInLoop(std::string&& message);
   void sendInLoop(const std::string_view& message);
   void sendInLoop(const void* message, size_t len);
+  void sendInLoop(std::string&& message);
+  void sendInLoop(Buffer&& message);
+  void sendInLoop(Slice&& message);
+  // Writes directly if nothing queued, returns false on fault error.
+  bool writeInLoop(const void* message, size_t len, size_t* nwrote);
+  void handleOutputQueued(size_t oldLen);
+  // Writes the messages corked in this iteration.
+  void flushCorked();
+  [[nodiscard]] bool isZeroCopyable(size_t len) const {
+    return outputBuffer_.zeroCopyThreshold() != 0 &&
+           len >= outputBuffer_.zeroCopyThreshold();
+  }
+  // Writes the output queue directly if nothing was queued before the last
+  // append, which grew it from oldLen.
+  void writeAppendedInLoop(size_t oldLen);
+  // Returns false if there's no completion.
+  bool handleZeroCopyCompletions();
+  // Takes the ownership of fd.
+  void sendFileInLoop(int fd, off_t offset, size_t length);
   void shutdownInLoop();
   // void shutdownAndForceCloseInLoop(double seconds);
   void forceCloseInLoop();
-  void setState(StateE s) { state_ = s; }
+  // Acquire & release, a thread seeing kConnected sees the connection set up.
+  StateE state() const { return state_.load(std::memory_order_acquire); }
+  void setState(StateE s) { state_.store(s, std::memory_order_release); }
+  // Returns false if the state isn't @c from, e.g. raced by another thread.
+  bool transitState(StateE from, StateE to) {
+    return state_.compare_exchange_strong(from, to, std::memory_order_acq_rel);
+  }
+  // From kConnected or kDisconnecting, returns false if it's neither.
+  bool startDisconnecting();
   const char* stateToString() const;
   void startReadInLoop();
   void stopReadInLoop();
+  // Counted, reading resumes once all the pauses are undone.
+  void pauseReadInLoop(bool pause);
+  // Pauses or resumes the upstream as the output queue crosses the marks.
+  void updateBackpressure() {
+    if (backpressureHighMark_ != 0) {
+      updateBackpressureSlow();
+    }
+  }
+  void updateBackpressureSlow();
+  void setUpstreamPaused(bool paused);
+  void releaseUpstream();
+  void adaptReadSize(size_t lastRead);
+  void touchWrite();
+  // Counts a read syscall, which read n bytes or failed.
+  void countRead(ssize_t n);
+  // Counts a write syscall, partial if it left bytes queued.
+  void countWrite(ssize_t n, bool partial);
+  // Polls for writable to flush the bytes queued, or for readable if the pipe
+  // at the front of the output queue is empty.
+  void waitWritable();
+  // Returns false if the front of the output queue isn't an empty pipe.
+  bool waitForPipe();
+  bool waitingForPipe() const;
+  void handlePipeReadable();
+  void stopWaitingForPipe();
+  // When the current iteration of the loop starts.
+  absl::Time iterationTime() const;
+  void recycleInputBuffer();
+  // Draws the storage of an empty buffer, to be the input buffer, from the
+  // loop pool.
+  void allocateInputBuffer(Buffer* buffer, size_t size);
+
+  static const size_t kMinReadSize = 2 * 1024;
+  static const size_t kInitialReadSize = 64 * 1024;
+  // Shrink the input buffer grows beyond it once mostly consumed.
+  static const size_t kShrinkCapacity = 256 * 1024;
 
   EventLoop* loop_;
   const std::string name_;
-  StateE state_;  // FIXME: use atomic variable
+  const ConnectionId id_;
+  // Read in any thread, e.g. by a cross-thread send, written with CAS.
+  std::atomic<StateE> state_;
   bool reading_;
   // we don't expose those classes to client.
   std::unique_ptr<Socket> socket_;
@@ -165,11 +324,44 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   HighWaterMarkCallback highWaterMarkCallback_;
   CloseCallback closeCallback_;
   size_t highWaterMark_;
+  size_t readBudget_;
+  // Bytes to ask for in the next read, learned from the recent reads.
+  size_t readSize_;
+  int smallReads_;
   Buffer inputBuffer_;
-  Buffer outputBuffer_;  // FIXME: use list<Buffer> as output buffer.
+  // The size its storage is allocated from the loop pool for, 0 if it holds
+  // none from the pool.
+  size_t inputBlockSize_{0};
+  // Destroyed before socket_, releasing the zero-copy payloads not completed
+  // while the fd is still open, see setZeroCopy.
+  ChainBuffer outputBuffer_;
+  // Polls the empty pipe at the front of outputBuffer_, writing is disabled
+  // meanwhile.
+  std::unique_ptr<Channel> pipeChannel_;
   std::any context_;
-  // FIXME: creationTime_, lastReceiveTime_
-  //        bytesReceived_, bytesSent_
+  const absl::Time creationTime_;
+  std::unique_ptr<IdleTimeoutEntry> idleEntry_;
+  // The connection feeding this one, 0 high-water mark if there's none.
+  std::weak_ptr<TcpConnection> upstream_;
+  size_t backpressureHighMark_{0};
+  size_t backpressureLowMark_{0};
+  bool upstreamPaused_{false};
+  // Downstream connections above their high-water marks.
+  int readPauses_{0};
+  bool cork_{false};
+  bool flushScheduled_{false};
+  // Written in the loop thread only, see stats().
+  std::atomic<int64_t> bytesReceived_{0};
+  std::atomic<int64_t> bytesSent_{0};
+  std::atomic<int64_t> reads_{0};
+  std::atomic<int64_t> writes_{0};
+  std::atomic<int64_t> partialWrites_{0};
+  std::atomic<int64_t> maxQueuedBytes_{0};
+  std::atomic<int64_t> writeBlockedNanos_{0};
+  std::atomic<int64_t> lastReadNanos_;
+  std::atomic<int64_t> lastWriteNanos_;
+  // Since when the bytes queued wait for writable.
+  absl::Time writeBlockedSince_;
 };
 
 }  // namespace net
@@ -0,0 +1,600 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/tcp_connection.h"
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "one/jinduo/net/event_loop.h"
+#include "one/jinduo/net/event_loop_thread.h"
+#include "one/jinduo/net/inet_address.h"
+#include "one/jinduo/net/slice.h"
+
+using jinduo::net::Buffer;
+using jinduo::net::EventLoop;
+using jinduo::net::EventLoopThread;
+using jinduo::net::InetAddress;
+using jinduo::net::TcpConnection;
+
+namespace {
+
+using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+
+// A connection over one end of a socketpair, the other end is `*peer`.
+// The connection is destroyed & the loop quits once it's closed.
+TcpConnectionPtr NewConnection(EventLoop* loop, int* peer,
+                               bool edgeTriggered = false) {
+  int fds[2];
+  EXPECT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds));
+  *peer = fds[1];
+  auto conn = std::make_shared<TcpConnection>(loop, "conn", fds[0],
+                                              InetAddress(), InetAddress());
+  conn->setConnectionCallback(jinduo::net::defaultConnectionCallback);
+  conn->setCloseCallback([loop](const TcpConnectionPtr& c) {
+    loop->QueueInLoop([c, loop] {
+      c->connectDestroyed();
+      loop->Quit();
+    });
+  });
+  if (edgeTriggered) {
+    EXPECT_TRUE(conn->setEdgeTriggered(true));
+  }
+  return conn;
+}
+
+// A connection whose output queue is left at about @c queued bytes, as its
+// peer doesn't read.
+TcpConnectionPtr NewStuckConnection(EventLoop* loop, int* peer,
+                                    size_t queued) {
+  TcpConnectionPtr conn = NewConnection(loop, peer);
+  conn->connectEstablished();
+  // Fills the socket buffer first.
+  conn->send(std::string(queued, 'x'));
+  while (conn->outputBuffer()->readableBytes() < queued) {
+    conn->send(std::string(64 * 1024, 'x'));
+  }
+  return conn;
+}
+
+// A loopback TCP connection, MSG_ZEROCOPY needs one. Both ends are
+// nonblocking.
+void ConnectLoopback(int* fd, int* peer) {
+  int listener = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ASSERT_GE(listener, 0);
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addrlen = sizeof addr;
+  ASSERT_EQ(0, ::bind(listener, reinterpret_cast<sockaddr*>(&addr), addrlen));
+  ASSERT_EQ(0, ::listen(listener, 1));
+  ASSERT_EQ(
+      0, ::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addrlen));
+  *fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ASSERT_EQ(0, ::connect(*fd, reinterpret_cast<sockaddr*>(&addr), addrlen));
+  *peer = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+  ASSERT_GE(*peer, 0);
+  ::close(listener);
+  ::fcntl(*fd, F_SETFL, O_NONBLOCK);
+}
+
+// Reads whatever is in the nonblocking fd.
+size_t Drain(int fd) {
+  char buf[64 * 1024];
+  size_t total = 0;
+  ssize_t n;
+  while ((n = ::read(fd, buf, sizeof buf)) > 0) {
+    total += static_cast<size_t>(n);
+  }
+  return total;
+}
+
+constexpr size_t kHighWaterMark = 1 << 20;
+constexpr size_t kLowWaterMark = 64 * 1024;
+
+// Runs @c f in each of @c n threads at once.
+template <typename F>
+void RunInThreads(int n, F f) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < n; ++i) {
+    threads.emplace_back(f);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace
+
+TEST(TcpConnection, EdgeTriggeredSeesFinAlongWithData) {
+  EventLoop loop;
+  int peer = -1;
+  TcpConnectionPtr conn = NewConnection(&loop, &peer, true);
+  std::string received;
+  conn->setMessageCallback(
+      [&](const TcpConnectionPtr&, Buffer* buf, absl::Time) {
+        received += buf->retrieveAllAsString();
+      });
+  conn->connectEstablished();
+  // The FIN arrives along with the data, raising a single edge.
+  ASSERT_EQ(5, ::write(peer, "hello", 5));
+  ::shutdown(peer, SHUT_WR);
+  loop.RunAfter(absl::Seconds(5), [&] { loop.Quit(); });
+  loop.Loop();
+  EXPECT_EQ("hello", received);
+  EXPECT_TRUE(conn->disconnected());
+  ::close(peer);
+}
+
+TEST(TcpConnection, SendFileWaitsForEmptyPipe) {
+  for (bool edgeTriggered : {false, true}) {
+    EventLoop loop;
+    int peer = -1;
+    TcpConnectionPtr conn = NewConnection(&loop, &peer, edgeTriggered);
+    conn->connectEstablished();
+    int pipes[2];
+    ASSERT_EQ(0, ::pipe(pipes));
+    conn->sendFile(pipes[0], 0, 10);
+    ::close(pipes[0]);
+    loop.RunAfter(absl::Milliseconds(50),
+                  [&] { ASSERT_EQ(5, ::write(pipes[1], "hello", 5)); });
+    // The rest of the region is truncated by EOF.
+    loop.RunAfter(absl::Milliseconds(100), [&] { ::close(pipes[1]); });
+    loop.RunAfter(absl::Milliseconds(150), [&] { loop.Quit(); });
+    loop.Loop();
+    char buf[16];
+    EXPECT_EQ(5, ::read(peer, buf, sizeof buf));
+    EXPECT_EQ("hello", std::string(buf, 5));
+    EXPECT_EQ(0U, conn->outputBuffer()->readableBytes());
+    // No spinning on EAGAIN while the pipe is empty.
+    EXPECT_LT(conn->stats().writes, 5);
+    conn->connectDestroyed();
+    ::close(peer);
+  }
+}
+
+TEST(TcpConnection, InputBufferGoesBackToPool) {
+  EventLoop loop;
+  int peer = -1;
+  TcpConnectionPtr conn = NewConnection(&loop, &peer);
+  const size_t kTotal = 512 * 1024;
+  size_t received = 0;
+  conn->setMessageCallback(
+      [&](const TcpConnectionPtr&, Buffer* buf, absl::Time) {
+        // Let it grow beyond a pooled block, then keep a partial message so
+        // the storage is shrunk instead of released.
+        if (buf->readableBytes() >= 300 * 1024) {
+          received += buf->readableBytes() - 10;
+          buf->retrieve(buf->readableBytes() - 10);
+        }
+      });
+  conn->connectEstablished();
+  const std::string chunk(16 * 1024, 'x');
+  size_t sent = 0;
+  loop.RunEvery(absl::Milliseconds(1), [&] {
+    while (sent < kTotal) {
+      ssize_t n = ::write(peer, chunk.data(), chunk.size());
+      if (n <= 0) {
+        return;
+      }
+      sent += static_cast<size_t>(n);
+    }
+    if (peer >= 0) {
+      ::close(peer);
+      peer = -1;
+    }
+  });
+  loop.RunAfter(absl::Seconds(5), [&] { loop.Quit(); });
+  loop.Loop();
+  EXPECT_TRUE(conn->disconnected());
+  EXPECT_GT(received, 0U);
+  for (const auto& stats : loop.buffer_pool_stats()) {
+    EXPECT_EQ(0, stats.outstanding_blocks) << stats.block_size;
+  }
+}
+
+TEST(TcpConnection, BackpressurePausesUpstreamUntilAllDrain) {
+  EventLoop loop;
+  int upstreamPeer = -1;
+  TcpConnectionPtr upstream = NewConnection(&loop, &upstreamPeer);
+  upstream->setMessageCallback(jinduo::net::defaultMessageCallback);
+  upstream->connectEstablished();
+  int peers[2];
+  TcpConnectionPtr conns[2];
+  for (int i = 0; i < 2; ++i) {
+    conns[i] = NewStuckConnection(&loop, &peers[i], 2 * kHighWaterMark);
+    conns[i]->setBackpressure(upstream, kHighWaterMark, kLowWaterMark);
+  }
+  ASSERT_EQ(5, ::write(upstreamPeer, "hello", 5));
+  bool draining[2] = {false, false};
+  loop.RunEvery(absl::Milliseconds(1), [&] {
+    for (int i = 0; i < 2; ++i) {
+      if (draining[i]) {
+        Drain(peers[i]);
+      }
+    }
+  });
+  loop.RunAfter(absl::Milliseconds(50), [&] {
+    EXPECT_EQ(0, upstream->stats().bytes_received);
+    draining[0] = true;
+  });
+  // Still paused by the other connection.
+  loop.RunAfter(absl::Milliseconds(300), [&] {
+    EXPECT_EQ(0U, conns[0]->outputBuffer()->readableBytes());
+    EXPECT_EQ(0, upstream->stats().bytes_received);
+    draining[1] = true;
+  });
+  loop.RunAfter(absl::Milliseconds(550), [&] { loop.Quit(); });
+  loop.Loop();
+  EXPECT_EQ(0U, conns[1]->outputBuffer()->readableBytes());
+  EXPECT_EQ(5, upstream->stats().bytes_received);
+  for (int i = 0; i < 2; ++i) {
+    conns[i]->connectDestroyed();
+    ::close(peers[i]);
+  }
+  upstream->connectDestroyed();
+  ::close(upstreamPeer);
+}
+
+TEST(TcpConnection, BackpressureResumesUpstreamOnClose) {
+  EventLoop loop;
+  int upstreamPeer = -1;
+  TcpConnectionPtr upstream = NewConnection(&loop, &upstreamPeer);
+  upstream->setMessageCallback(jinduo::net::defaultMessageCallback);
+  upstream->connectEstablished();
+  int peer = -1;
+  TcpConnectionPtr conn = NewStuckConnection(&loop, &peer, 2 * kHighWaterMark);
+  conn->setCloseCallback(
+      [](const TcpConnectionPtr& c) { c->connectDestroyed(); });
+  conn->setBackpressure(upstream, kHighWaterMark, kLowWaterMark);
+  ASSERT_EQ(5, ::write(upstreamPeer, "hello", 5));
+  loop.RunAfter(absl::Milliseconds(50), [&] {
+    EXPECT_EQ(0, upstream->stats().bytes_received);
+    // Closed with the queue still full.
+    ::close(peer);
+  });
+  loop.RunAfter(absl::Milliseconds(200), [&] { loop.Quit(); });
+  loop.Loop();
+  EXPECT_TRUE(conn->disconnected());
+  EXPECT_EQ(5, upstream->stats().bytes_received);
+  upstream->connectDestroyed();
+  ::close(upstreamPeer);
+}
+
+TEST(TcpConnection, BackpressureAcrossLoops) {
+  EventLoopThread thread;
+  EventLoop* upstreamLoop = thread.StartLoop();
+  int upstreamPeer = -1;
+  TcpConnectionPtr upstream;
+  {
+    std::promise<void> created;
+    upstreamLoop->RunInLoop([&] {
+      upstream = NewConnection(upstreamLoop, &upstreamPeer);
+      upstream->setMessageCallback(jinduo::net::defaultMessageCallback);
+      upstream->connectEstablished();
+      created.set_value();
+    });
+    created.get_future().wait();
+  }
+  EventLoop loop;
+  int peer = -1;
+  TcpConnectionPtr conn = NewStuckConnection(&loop, &peer, 2 * kHighWaterMark);
+  conn->setBackpressure(upstream, kHighWaterMark, kLowWaterMark);
+  {
+    // The pause is queued to the upstream loop, wait for it to be done.
+    std::promise<void> paused;
+    upstreamLoop->QueueInLoop([&] { paused.set_value(); });
+    paused.get_future().wait();
+  }
+  ASSERT_EQ(5, ::write(upstreamPeer, "hello", 5));
+  bool draining = false;
+  loop.RunEvery(absl::Milliseconds(1), [&] {
+    if (draining) {
+      Drain(peer);
+    }
+  });
+  loop.RunAfter(absl::Milliseconds(50), [&] {
+    EXPECT_EQ(0, upstream->stats().bytes_received);
+    draining = true;
+  });
+  loop.RunAfter(absl::Milliseconds(300), [&] { loop.Quit(); });
+  loop.Loop();
+  EXPECT_EQ(0U, conn->outputBuffer()->readableBytes());
+  EXPECT_EQ(5, upstream->stats().bytes_received);
+  conn->connectDestroyed();
+  ::close(peer);
+  std::promise<void> destroyed;
+  upstreamLoop->RunInLoop([&] {
+    upstream->connectDestroyed();
+    destroyed.set_value();
+  });
+  destroyed.get_future().wait();
+  ::close(upstreamPeer);
+}
+
+TEST(TcpConnection, CorkWritesOncePerIteration) {
+  EventLoop loop;
+  int peer = -1;
+  TcpConnectionPtr conn = NewConnection(&loop, &peer);
+  conn->setCork(true);
+  conn->connectEstablished();
+  int64_t writes = -1;
+  loop.QueueInLoop([&] {
+    for (int i = 0; i < 10; ++i) {
+      conn->send("hello");
+    }
+    // Nothing is written until the end of the iteration.
+    EXPECT_EQ(0, conn->stats().writes);
+    EXPECT_EQ(50U, conn->outputBuffer()->readableBytes());
+  });
+  loop.RunAfter(absl::Milliseconds(50), [&] {
+    writes = conn->stats().writes;
+    loop.Quit();
+  });
+  loop.Loop();
+  EXPECT_EQ(1, writes);
+  char buf[64];
+  EXPECT_EQ(50, ::read(peer, buf, sizeof buf));
+  conn->connectDestroyed();
+  ::close(peer);
+}
+
+TEST(TcpConnection, ShutdownWaitsForCorkedMessages) {
+  EventLoop loop;
+  int peer = -1;
+  TcpConnectionPtr conn = NewConnection(&loop, &peer);
+  conn->setCork(true);
+  conn->connectEstablished();
+  loop.QueueInLoop([&] {
+    conn->send("hello");
+    conn->send("world");
+    conn->shutdown();
+  });
+  std::string received;
+  bool eof = false;
+  loop.RunEvery(absl::Milliseconds(1), [&] {
+    char buf[64];
+    ssize_t n;
+    while (!eof && (n = ::read(peer, buf, sizeof buf)) >= 0) {
+      received.append(buf, n);
+      // The FIN follows the data, the connection closes once the peer does.
+      if (n == 0) {
+        eof = true;
+        ::close(peer);
+      }
+    }
+  });
+  loop.RunAfter(absl::Seconds(5), [&] { loop.Quit(); });
+  loop.Loop();
+  EXPECT_TRUE(eof);
+  EXPECT_EQ("helloworld", received);
+  EXPECT_TRUE(conn->disconnected());
+}
+
+TEST(TcpConnection, RacingClosesQueueOnce) {
+  EventLoop loop;
+  int peer = -1;
+  TcpConnectionPtr conn = NewConnection(&loop, &peer);
+  conn->connectEstablished();
+  ASSERT_TRUE(conn->connected());
+  const size_t queued = loop.queue_size();
+  // Only the winner moves it to kDisconnecting & queues the shutdown.
+  RunInThreads(4, [&] { conn->shutdown(); });
+  EXPECT_FALSE(conn->connected());
+  EXPECT_FALSE(conn->disconnected());
+  EXPECT_EQ(queued + 1, loop.queue_size());
+  // A force close still goes on from kDisconnecting.
+  RunInThreads(1, [&] { conn->forceClose(); });
+  EXPECT_EQ(queued + 2, loop.queue_size());
+  loop.RunAfter(absl::Seconds(5), [&] { loop.Quit(); });
+  loop.Loop();
+  EXPECT_TRUE(conn->disconnected());
+  ::close(peer);
+}
+
+TEST(TcpConnection, ClosedRejectsSendsWithoutQueueing) {
+  EventLoop loop;
+  int peer = -1;
+  TcpConnectionPtr conn = NewConnection(&loop, &peer);
+  conn->connectEstablished();
+  conn->forceClose();
+  loop.RunAfter(absl::Seconds(5), [&] { loop.Quit(); });
+  loop.Loop();
+  ASSERT_TRUE(conn->disconnected());
+  const size_t queued = loop.queue_size();
+  int pipes[2];
+  ASSERT_EQ(0, ::pipe(pipes));
+  RunInThreads(4, [&] {
+    for (int i = 0; i < 100; ++i) {
+      conn->send(std::string_view("hello"));
+      conn->send(std::string("hello"));
+      conn->send(Buffer());
+      conn->sendFile(pipes[0], 0, 5);
+      conn->shutdown();
+      conn->forceClose();
+    }
+  });
+  EXPECT_EQ(queued, loop.queue_size());
+  EXPECT_TRUE(conn->disconnected());
+  ::close(pipes[0]);
+  ::close(pipes[1]);
+  ::close(peer);
+}
+
+TEST(TcpConnection, CountedInLoopOnceEstablished) {
+  EventLoop loop;
+  int peer = -1;
+  TcpConnectionPtr conn = NewConnection(&loop, &peer);
+  EXPECT_EQ(0, loop.num_connections());
+  conn->connectEstablished();
+  EXPECT_EQ(1, loop.num_connections());
+  conn->connectDestroyed();
+  EXPECT_EQ(0, loop.num_connections());
+  ::close(peer);
+}
+
+TEST(TcpConnection, ZeroCopyHoldsPayloadUntilCompleted) {
+  int fd = -1;
+  int peer = -1;
+  ASSERT_NO_FATAL_FAILURE(ConnectLoopback(&fd, &peer));
+  EventLoop loop;
+  auto conn = std::make_shared<TcpConnection>(&loop, "conn", fd,
+                                              InetAddress(), InetAddress());
+  conn->setConnectionCallback(jinduo::net::defaultConnectionCallback);
+  if (!conn->setZeroCopy(64 * 1024)) {
+    conn->connectEstablished();
+    conn->connectDestroyed();
+    ::close(peer);
+    GTEST_SKIP() << "SO_ZEROCOPY is not supported";
+  }
+  conn->connectEstablished();
+  auto bytes = std::make_shared<const jinduo::net::Bytes>(1 << 20, 'z');
+  conn->send("head");
+  conn->send(bytes);
+  conn->send("tail");
+  std::string received;
+  loop.RunEvery(absl::Milliseconds(1), [&] {
+    char buf[64 * 1024];
+    ssize_t n;
+    while ((n = ::read(peer, buf, sizeof buf)) > 0) {
+      received.append(buf, n);
+    }
+    // Released by the completion, after all the bytes went out.
+    if (received.size() == bytes->size() + 8 && bytes.use_count() == 1) {
+      loop.Quit();
+    }
+  });
+  loop.RunAfter(absl::Seconds(5), [&] { loop.Quit(); });
+  loop.Loop();
+  EXPECT_EQ("head" + *bytes + "tail", received);
+  EXPECT_EQ(1, bytes.use_count());
+  EXPECT_EQ(0U, conn->outputBuffer()->readableBytes());
+  conn->connectDestroyed();
+  ::close(peer);
+}
+
+TEST(TcpConnection, CountsBytesOnConnectionAndLoop) {
+  EventLoop loop;
+  int peers[2];
+  TcpConnectionPtr conns[2];
+  const std::string payloads[2] = {std::string(1000, 'a'),
+                                   std::string(3000, 'b')};
+  int closed = 0;
+  for (int i = 0; i < 2; ++i) {
+    conns[i] = NewConnection(&loop, &peers[i]);
+    // Echoes the messages back.
+    conns[i]->setMessageCallback(
+        [](const TcpConnectionPtr& c, Buffer* buf, absl::Time) {
+          c->send(buf);
+        });
+    conns[i]->setCloseCallback([&](const TcpConnectionPtr& c) {
+      loop.QueueInLoop([c, &loop, &closed] {
+        c->connectDestroyed();
+        if (++closed == 2) {
+          loop.Quit();
+        }
+      });
+    });
+    conns[i]->connectEstablished();
+    ASSERT_EQ(static_cast<ssize_t>(payloads[i].size()),
+              ::write(peers[i], payloads[i].data(), payloads[i].size()));
+  }
+  std::string echoed[2];
+  loop.RunEvery(absl::Milliseconds(1), [&] {
+    for (int i = 0; i < 2; ++i) {
+      char buf[4096];
+      ssize_t n;
+      while (peers[i] >= 0 && (n = ::read(peers[i], buf, sizeof buf)) > 0) {
+        echoed[i].append(buf, n);
+      }
+      if (peers[i] >= 0 && echoed[i].size() == payloads[i].size()) {
+        ::close(peers[i]);
+        peers[i] = -1;
+      }
+    }
+  });
+  loop.RunAfter(absl::Seconds(5), [&] { loop.Quit(); });
+  loop.Loop();
+  int64_t total = 0;
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(payloads[i], echoed[i]);
+    const int64_t size = static_cast<int64_t>(payloads[i].size());
+    EXPECT_EQ(size, conns[i]->stats().bytes_received);
+    EXPECT_EQ(size, conns[i]->stats().bytes_sent);
+    EXPECT_GE(conns[i]->stats().reads, 2);  // The EOF included.
+    EXPECT_GE(conns[i]->stats().writes, 1);
+    total += size;
+  }
+  // The sums of both connections, published when the loop quits.
+  EXPECT_EQ(total, loop.stats().bytes_received);
+  EXPECT_EQ(total, loop.stats().bytes_sent);
+  EXPECT_EQ(conns[0]->stats().reads + conns[1]->stats().reads,
+            loop.stats().reads);
+  EXPECT_EQ(conns[0]->stats().writes + conns[1]->stats().writes,
+            loop.stats().writes);
+}
+
+TEST(TcpConnection, ReadBudgetYieldsToLoop) {
+  EventLoop loop;
+  int peer = -1;
+  TcpConnectionPtr conn = NewConnection(&loop, &peer);
+  conn->setReadBudget(16 * 1024);
+  std::vector<size_t> messages;
+  bool queuedRun = false;
+  size_t receivedBeforeQueuedRun = 0;
+  size_t received = 0;
+  conn->setMessageCallback(
+      [&](const TcpConnectionPtr&, Buffer* buf, absl::Time) {
+        if (messages.empty()) {
+          loop.QueueInLoop([&] {
+            queuedRun = true;
+            receivedBeforeQueuedRun = received;
+          });
+        }
+        messages.push_back(buf->readableBytes());
+        received += buf->readableBytes();
+        buf->retrieveAll();
+      });
+  conn->connectEstablished();
+  // Pending well beyond the budget before the loop reads any.
+  const std::string chunk(4096, 'x');
+  size_t sent = 0;
+  ssize_t n;
+  while ((n = ::write(peer, chunk.data(), chunk.size())) > 0) {
+    sent += static_cast<size_t>(n);
+  }
+  ASSERT_GT(sent, 4 * 16 * 1024U);
+  ::shutdown(peer, SHUT_WR);
+  loop.RunAfter(absl::Seconds(5), [&] { loop.Quit(); });
+  loop.Loop();
+  EXPECT_TRUE(conn->disconnected());
+  EXPECT_EQ(sent, received);
+  // Delivered in several turns, with the functors run in between.
+  EXPECT_GE(messages.size(), 2U);
+  EXPECT_TRUE(queuedRun);
+  EXPECT_LT(receivedBeforeQueuedRun, sent);
+  ::close(peer);
+}
@@ -25,43 +25,113 @@
 
 #include "one/jinduo/net/tcp_server.h"
 
-#include <stdio.h>  // snprintf
-
+#include <algorithm>
 #include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/functional/bind_front.h"
+#include "absl/strings/str_cat.h"
 #include "glog/logging.h"
+#include "one/base/future.h"
 #include "one/jinduo/net/event_loop.h"
 #include "one/jinduo/net/event_loop_thread_pool.h"
 #include "one/jinduo/net/internal/acceptor.h"
+#include "one/jinduo/net/internal/connection_registry.h"
+#include "one/jinduo/net/internal/idle_timeouts.h"
 #include "one/jinduo/net/internal/sockets_ops.h"
 
 namespace jinduo {
 namespace net {
 
+namespace {
+
+// The future is ready once `f` has run in `loop`.
+hcoona::Future<void> runInLoopFuture(EventLoop* loop,
+                                     hcoona::SmallFunction<void()> f) {
+  hcoona::Promise<void> done;
+  hcoona::Future<void> future = done.GetFuture();
+  loop->RunInLoop([f = std::move(f), done = std::move(done)]() mutable {
+    f();
+    done.SetValue();
+  });
+  return future;
+}
+
+void waitFor(hcoona::Future<void>* future) {
+  try {
+    future->Get();
+  } catch (const std::future_error& e) {
+    // Broken if the loop is destroyed before running it, nothing to wait for.
+    LOG(ERROR) << "TcpServer::~TcpServer: " << e.what();
+  }
+}
+
+void establishConnection(ConnectionRegistry* registry,
+                         const std::shared_ptr<TcpConnection>& conn) {
+  registry->Add(conn);
+  conn->connectEstablished();
+}
+
+}  // namespace
+
+struct TcpServer::Shard {
+  EventLoop* loop;
+  std::unique_ptr<Acceptor> acceptor;
+  // The registry of `loop` if kReusePortPerLoop.
+  ConnectionRegistry* registry;
+};
+
 TcpServer::TcpServer(EventLoop* loop, const InetAddress& listenAddr,
                      std::string nameArg, Option option)
     : loop_(CHECK_NOTNULL(loop)),
       ipPort_(listenAddr.toIpPort()),
       name_(std::move(nameArg)),
-      acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+      connNamePrefix_(absl::StrCat(name_, "-", ipPort_, "#")),
+      option_(option),
       threadPool_(new EventLoopThreadPool(loop, name_)),
       connectionCallback_(defaultConnectionCallback),
-      messageCallback_(defaultMessageCallback) {
-  acceptor_->SetNewConnectionCallback(
-      absl::bind_front(&TcpServer::newConnection, this));
+      messageCallback_(defaultMessageCallback),
+      connectionTimeoutCallback_(defaultConnectionTimeoutCallback) {
+  // Bind it here to fail early if the address is in use.
+  auto* shard = new Shard{loop, nullptr, nullptr};
+  shard->acceptor = std::make_unique<Acceptor>(loop, listenAddr,
+                                               option != kNoReusePort);
+  shard->acceptor->SetNewConnectionCallback(
+      absl::bind_front(&TcpServer::newConnection, this, shard));
+  shards_.emplace_back(shard);
 }
 
 TcpServer::~TcpServer() {
   loop_->AssertInLoopThread();
   VLOG(1) << "TcpServer::~TcpServer [" << name_ << "] destructing";
 
-  for (auto& item : connections_) {
-    std::shared_ptr<TcpConnection> conn(item.second);
-    item.second.reset();
-    conn->getLoop()->RunInLoop(
-        absl::bind_front(&TcpConnection::connectDestroyed, conn));
+  for (auto& item : idleTimeouts_) {
+    item.second->Stop();
+  }
+
+  // The io loops keep running until the thread pool is gone, wait for them to
+  // drop their acceptors & connections, which call back into this server.
+  // Queued to all of them first, each loop drops its acceptor before its
+  // connections, while the loops do it in parallel.
+  std::vector<hcoona::Future<void>> done;
+  for (auto& shard : shards_) {
+    done.push_back(runInLoopFuture(
+        shard->loop, [acceptor = std::move(shard->acceptor)]() mutable {
+          acceptor.reset();
+        }));
+  }
+  for (auto& registry : registries_) {
+    done.push_back(runInLoopFuture(
+        registry->loop(), absl::bind_front(&TcpServer::destroyConnectionsInLoop,
+                                           this, registry.get())));
+  }
+  for (hcoona::Future<void>& future : done) {
+    waitFor(&future);
   }
 }
 
@@ -70,57 +140,160 @@ void TcpServer::set_thread_num(int numThreads) {
   threadPool_->set_thread_num(numThreads);
 }
 
+void TcpServer::setCpuAffinity(std::vector<int> cpus, bool numaLocal) {
+  threadPool_->set_cpu_affinity(std::move(cpus));
+  threadPool_->set_numa_local(numaLocal);
+}
+
+void TcpServer::setLoopSelector(std::unique_ptr<LoopSelector> selector) {
+  threadPool_->set_loop_selector(std::move(selector));
+}
+
 void TcpServer::start() {
   bool expected = false;
   if (started_.compare_exchange_strong(expected, true,
                                        std::memory_order_acq_rel)) {
     threadPool_->Start(threadInitCallback_);
 
-    assert(!acceptor_->listening());
-    loop_->RunInLoop(absl::bind_front(&Acceptor::Listen, acceptor_.get()));
+    for (EventLoop* ioLoop : threadPool_->all_loops()) {
+      CHECK_LT(registries_.size(), ConnectionRegistry::kMaxRegistries);
+      registries_.push_back(std::make_unique<ConnectionRegistry>(
+          ioLoop, static_cast<uint32_t>(registries_.size())));
+      registryByLoop_[ioLoop] = registries_.back().get();
+    }
+
+    if (readIdleTimeout_ > absl::ZeroDuration() ||
+        writeIdleTimeout_ > absl::ZeroDuration() ||
+        maxLifetime_ > absl::ZeroDuration()) {
+      for (EventLoop* ioLoop : threadPool_->all_loops()) {
+        auto timeouts = std::make_shared<IdleTimeouts>(
+            ioLoop, readIdleTimeout_, writeIdleTimeout_, maxLifetime_,
+            connectionTimeoutCallback_);
+        timeouts->Start();
+        idleTimeouts_[ioLoop] = std::move(timeouts);
+      }
+    }
+
+    if (option_ == kReusePortPerLoop) {
+      // Join the SO_REUSEPORT group of the reserved socket, on the port picked
+      // by the kernel if it was 0.
+      const InetAddress listenAddr = shards_[0]->acceptor->GetListenAddress();
+      for (EventLoop* ioLoop : threadPool_->all_loops()) {
+        auto* shard = new Shard{ioLoop, nullptr, registryByLoop_[ioLoop]};
+        shard->acceptor = std::make_unique<Acceptor>(ioLoop, listenAddr,
+                                                     /*reuse_port=*/true);
+        shard->acceptor->SetNewConnectionCallback(
+            absl::bind_front(&TcpServer::newConnection, this, shard));
+        shards_.emplace_back(shard);
+      }
+    }
+
+    // The reserved socket of kReusePortPerLoop only holds the port.
+    const size_t first = option_ == kReusePortPerLoop ? 1 : 0;
+    for (size_t i = first; i < shards_.size(); ++i) {
+      Acceptor* acceptor = shards_[i]->acceptor.get();
+      assert(!acceptor->listening());
+      if (acceptBudget_ >= 0) {
+        acceptor->set_accept_budget(acceptBudget_);
+      }
+      shards_[i]->loop->RunInLoop(
+          absl::bind_front(&Acceptor::Listen, acceptor));
+    }
   }
 }
 
-void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
-  loop_->AssertInLoopThread();
-  EventLoop* ioLoop = threadPool_->GetNextLoop();
-  char buf[64];
-  snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-  ++nextConnId_;
-  std::string connName = name_ + buf;
+InetAddress TcpServer::listenAddress() const {
+  return shards_[0]->acceptor->GetListenAddress();
+}
+
+AcceptStats TcpServer::acceptStats() const {
+  AcceptStats total;
+  for (const auto& shard : shards_) {
+    AcceptStats stats = shard->acceptor->GetStats();
+    total.accepted += stats.accepted;
+    total.errors += stats.errors;
+    total.budget_exhausted += stats.budget_exhausted;
+    total.backlog_full += stats.backlog_full;
+    total.max_backlog = std::max(total.max_backlog, stats.max_backlog);
+  }
+  return total;
+}
+
+EventLoop* TcpServer::getLoopOf(ConnectionId id) const {
+  uint32_t index = ConnectionRegistry::IndexOf(id);
+  return index < registries_.size() ? registries_[index]->loop() : nullptr;
+}
+
+std::shared_ptr<TcpConnection> TcpServer::getConnection(ConnectionId id) const {
+  uint32_t index = ConnectionRegistry::IndexOf(id);
+  return index < registries_.size() ? registries_[index]->Find(id) : nullptr;
+}
+
+void TcpServer::newConnection(Shard* shard, int sockfd,
+                              const InetAddress& peerAddr) {
+  shard->loop->AssertInLoopThread();
+  EventLoop* ioLoop = nullptr;
+  if (option_ == kReusePortPerLoop) {
+    ioLoop = shard->loop;
+  } else if (incomingCpuAffinity_) {
+    ioLoop = threadPool_->GetLoopForCpu(sockets::getIncomingCpu(sockfd));
+  }
+  if (ioLoop == nullptr) {
+    ioLoop = threadPool_->GetNextLoop();
+  }
+  ConnectionRegistry* registry = shard->registry != nullptr
+                                     ? shard->registry
+                                     : registryByLoop_.at(ioLoop);
+  const ConnectionId id = registry->NextId();
+  std::string connName = absl::StrCat(connNamePrefix_, id);
 
   VLOG(1) << "TcpServer::newConnection [" << name_ << "] - new connection ["
           << connName << "] from " << peerAddr.toIpPort();
   InetAddress localAddr(sockets::getLocalAddr(sockfd));
   // FIXME poll with zero timeout to double confirm the new connection
-  // FIXME use make_shared if necessary
-  std::shared_ptr<TcpConnection> conn(
-      new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-  connections_[connName] = conn;
+  auto conn = std::make_shared<TcpConnection>(ioLoop, std::move(connName),
+                                              sockfd, localAddr, peerAddr, id);
+  if (busyPollUsec_ > 0) {
+    conn->setBusyPoll(busyPollUsec_);
+  }
+  if (edgeTriggered_ && !conn->setEdgeTriggered(true)) {
+    LOG(WARNING) << "TcpServer::newConnection [" << name_
+                 << "] - edge-triggered mode is not supported by the poller";
+  }
   conn->setConnectionCallback(connectionCallback_);
   conn->setMessageCallback(messageCallback_);
   conn->setWriteCompleteCallback(writeCompleteCallback_);
-  conn->setCloseCallback(
-      absl::bind_front(&TcpServer::removeConnection, this));  // FIXME: unsafe
-  ioLoop->RunInLoop(absl::bind_front(&TcpConnection::connectEstablished, conn));
+  if (std::shared_ptr<IdleTimeouts> timeouts = getIdleTimeouts(ioLoop)) {
+    conn->setIdleTimeouts(std::move(timeouts));
+  }
+  conn->setCloseCallback(absl::bind_front(&TcpServer::removeConnection, this,
+                                          registry));  // FIXME: unsafe
+  // Registered in its own loop, so closing it needs no hop to another loop.
+  ioLoop->RunInLoop(absl::bind_front(&establishConnection, registry, conn));
+}
+
+void TcpServer::removeConnection(ConnectionRegistry* registry,
+                                 const std::shared_ptr<TcpConnection>& conn) {
+  VLOG(1) << "TcpServer::removeConnection [" << name_ << "] - connection "
+          << conn->name();
+  bool removed = registry->Remove(conn->id());
+  (void)removed;
+  assert(removed);
+  // Destroy it after the channel finishes handling the close event.
+  conn->getLoop()->QueueInLoop(
+      absl::bind_front(&TcpConnection::connectDestroyed, conn));
 }
 
-void TcpServer::removeConnection(const std::shared_ptr<TcpConnection>& conn) {
-  // FIXME: unsafe
-  loop_->RunInLoop(
-      absl::bind_front(&TcpServer::removeConnectionInLoop, this, conn));
+void TcpServer::destroyConnectionsInLoop(ConnectionRegistry* registry) {
+  for (const std::shared_ptr<TcpConnection>& conn : registry->TakeAll()) {
+    conn->connectDestroyed();
+  }
 }
 
-void TcpServer::removeConnectionInLoop(
-    const std::shared_ptr<TcpConnection>& conn) {
-  loop_->AssertInLoopThread();
-  VLOG(1) << "TcpServer::removeConnectionInLoop [" << name_ << "] - connection "
-          << conn->name();
-  size_t n = connections_.erase(conn->name());
-  (void)n;
-  assert(n == 1);
-  EventLoop* ioLoop = conn->getLoop();
-  ioLoop->QueueInLoop(absl::bind_front(&TcpConnection::connectDestroyed, conn));
+std::shared_ptr<IdleTimeouts> TcpServer::getIdleTimeouts(
+    EventLoop* ioLoop) const {
+  auto it = idleTimeouts_.find(ioLoop);
+  return it != idleTimeouts_.end() ? it->second : nullptr;
 }
 
 }  // namespace net
@@ -31,15 +31,21 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "one/jinduo/net/accept_stats.h"
+#include "one/jinduo/net/inet_address.h"
+#include "one/jinduo/net/loop_selector.h"
 #include "one/jinduo/net/tcp_connection.h"
 
 namespace jinduo {
 namespace net {
 
 class Acceptor;
+class ConnectionRegistry;
 class EventLoop;
 class EventLoopThreadPool;
+class IdleTimeouts;
 
 ///
 /// TCP server, supports single-threaded and thread-pool models.
@@ -51,11 +57,20 @@ class TcpServer {
   enum Option {
     kNoReusePort,
     kReusePort,
+    /// Listens on a SO_REUSEPORT socket per io loop, the kernel spreads the
+    /// new connections over them by the hash of their addresses. Each io loop
+    /// accepts & owns its connections, with no handoff from the base loop, so
+    /// the loop selector & @c setIncomingCpuAffinity don't apply.
+    kReusePortPerLoop,
   };
 
   // TcpServer(EventLoop* loop, const InetAddress& listenAddr);
   TcpServer(EventLoop* loop, const InetAddress& listenAddr, std::string nameArg,
             Option option = kNoReusePort);
+  /// Must be called in the loop thread. It blocks until every io loop drops
+  /// the acceptors & connections of this server, so the io loops must still
+  /// be running, and must not wait for the loop meanwhile, e.g. in a
+  /// @c Future::Get of a functor queued to it, or it deadlocks.
   ~TcpServer();  // force out-line dtor, for std::unique_ptr members.
 
   // Disallow copy.
@@ -69,10 +84,12 @@ class TcpServer {
   [[nodiscard]] const std::string& ipPort() const { return ipPort_; }
   [[nodiscard]] const std::string& name() const { return name_; }
   [[nodiscard]] EventLoop* getLoop() const { return loop_; }
+  /// The bound address, with the port picked by the kernel if it was 0.
+  [[nodiscard]] InetAddress listenAddress() const;
 
   /// Set the number of threads for handling input.
   ///
-  /// Always accepts new connection in loop's thread.
+  /// Accepts new connection in loop's thread, unless kReusePortPerLoop.
   /// Must be called before @c start
   /// @param numThreads
   /// - 0 means all I/O in loop's thread, no thread will created.
@@ -81,6 +98,21 @@ class TcpServer {
   /// - N means a thread pool with N threads, new connections
   ///   are assigned on a round-robin basis.
   void set_thread_num(int numThreads);
+  /// Pins the io threads to the CPUs & keeps their memory on the local NUMA
+  /// node, see @c EventLoopThreadPool::set_cpu_affinity.
+  /// Must be called before @c start
+  void setCpuAffinity(std::vector<int> cpus, bool numaLocal = true);
+
+  /// Serves a new connection in the loop pinned to the CPU which received its
+  /// packets, by SO_INCOMING_CPU, if any, see
+  /// @c EventLoopThreadPool::set_cpu_affinity. Falls back to the loop
+  /// selector otherwise.
+  /// Must be called before @c start
+  void setIncomingCpuAffinity(bool on) { incomingCpuAffinity_ = on; }
+
+  /// Picks the io loop for each new connection, round-robin by default.
+  /// Must be called before @c start
+  void setLoopSelector(std::unique_ptr<LoopSelector> selector);
   void setThreadInitCallback(const ThreadInitCallback& cb) {
     threadInitCallback_ = cb;
   }
@@ -93,6 +125,32 @@ class TcpServer {
   /// Thread safe.
   void start();
 
+  /// Accepts at most @c budget connections per read event of a listening
+  /// socket, 64 by default, 0 for no limit. A lower budget keeps a connection
+  /// storm from starving the established connections of the accepting loop.
+  /// Must be called before @c start
+  void setAcceptBudget(int budget) { acceptBudget_ = budget; }
+
+  /// Thread safe once @c start returns.
+  [[nodiscard]] AcceptStats acceptStats() const;
+
+  /// The loop serving the connection of @c id, nullptr if there's none.
+  /// Thread safe once @c start returns.
+  [[nodiscard]] EventLoop* getLoopOf(ConnectionId id) const;
+
+  /// The connection of @c id in O(1), nullptr if it's closed.
+  ///
+  /// Not thread safe, call it in @c getLoopOf(id), e.g. to push a message
+  /// @code
+  /// server.getLoopOf(id)->RunInLoop([&server, id, message] {
+  ///   if (auto conn = server.getConnection(id)) {
+  ///     conn->send(message);
+  ///   }
+  /// });
+  /// @endcode
+  [[nodiscard]] std::shared_ptr<TcpConnection> getConnection(
+      ConnectionId id) const;
+
   /// Set connection callback.
   /// Not thread safe.
   void setConnectionCallback(const ConnectionCallback& cb) {
@@ -109,29 +167,87 @@ class TcpServer {
     writeCompleteCallback_ = cb;
   }
 
- private:
-  /// Not thread safe, but in loop
-  void newConnection(int sockfd, const InetAddress& peerAddr);
-  /// Thread safe.
-  void removeConnection(const std::shared_ptr<TcpConnection>& conn);
-  /// Not thread safe, but in loop
-  void removeConnectionInLoop(const std::shared_ptr<TcpConnection>& conn);
+  /// Set SO_BUSY_POLL in microseconds on the accepted sockets, 0 to disable.
+  /// Pairs with @c EventLoop::set_busy_poll_budget on the io loops.
+  /// Not thread safe.
+  void setBusyPoll(int usec) { busyPollUsec_ = usec; }
 
-  using ConnectionMap = std::map<std::string, std::shared_ptr<TcpConnection>>;
+  /// Polls the accepted sockets edge-triggered, see
+  /// @c TcpConnection::setEdgeTriggered.
+  /// Not thread safe.
+  void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+  /// Closes the connections receiving nothing for @c timeout, 0 to disable.
+  ///
+  /// The timeouts are checked by a timer per io loop, instead of one per
+  /// connection, so a connection may be closed a little later, up to 1/8 of
+  /// the shortest timeout.
+  /// Must be called before @c start
+  void setReadIdleTimeout(absl::Duration timeout) {
+    readIdleTimeout_ = timeout;
+  }
+
+  /// Closes the connections sending nothing for @c timeout, 0 to disable.
+  /// Must be called before @c start
+  void setWriteIdleTimeout(absl::Duration timeout) {
+    writeIdleTimeout_ = timeout;
+  }
+
+  /// Closes the connections established for @c timeout, 0 to disable.
+  /// Must be called before @c start
+  void setMaxLifetime(absl::Duration timeout) { maxLifetime_ = timeout; }
+
+  /// Called in the io loop instead of closing the connection on timeout, the
+  /// idle timeouts are reported again after another period unless it's closed,
+  /// e.g. to send a heartbeat on write idle.
+  /// Must be called before @c start
+  void setConnectionTimeoutCallback(const ConnectionTimeoutCallback& cb) {
+    connectionTimeoutCallback_ = cb;
+  }
+
+ private:
+  // An acceptor, owned by its loop.
+  struct Shard;
+
+  /// Not thread safe, but in the shard loop
+  void newConnection(Shard* shard, int sockfd, const InetAddress& peerAddr);
+  /// Not thread safe, but in the connection loop
+  void removeConnection(ConnectionRegistry* registry,
+                        const std::shared_ptr<TcpConnection>& conn);
+  /// Not thread safe, but in the loop
+  void destroyConnectionsInLoop(ConnectionRegistry* registry);
+  /// Thread safe after @c start, nullptr if there's no timeout.
+  std::shared_ptr<IdleTimeouts> getIdleTimeouts(EventLoop* ioLoop) const;
 
   EventLoop* loop_;  // the acceptor loop
   const std::string ipPort_;
   const std::string name_;
-  std::unique_ptr<Acceptor> acceptor_;  // avoid revealing Acceptor
+  // "name-ip:port#", followed by the connection id.
+  const std::string connNamePrefix_;
+  const Option option_;
   std::shared_ptr<EventLoopThreadPool> threadPool_;
+  // The first one listens in the base loop, unless kReusePortPerLoop, then
+  // it only reserves the address & a shard is added for each io loop.
+  std::vector<std::unique_ptr<Shard>> shards_;
+  // One per io loop created on start, indexed by ConnectionRegistry::IndexOf,
+  // read only then.
+  std::vector<std::unique_ptr<ConnectionRegistry>> registries_;
+  std::map<EventLoop*, ConnectionRegistry*> registryByLoop_;
   ConnectionCallback connectionCallback_;
   MessageCallback messageCallback_;
   WriteCompleteCallback writeCompleteCallback_;
+  ConnectionTimeoutCallback connectionTimeoutCallback_;
   ThreadInitCallback threadInitCallback_;
+  int acceptBudget_{-1};
+  int busyPollUsec_{0};
+  bool edgeTriggered_{false};
+  bool incomingCpuAffinity_{false};
+  absl::Duration readIdleTimeout_;
+  absl::Duration writeIdleTimeout_;
+  absl::Duration maxLifetime_;
   std::atomic<bool> started_{};
-  // always in loop thread
-  int nextConnId_{1};
-  ConnectionMap connections_;
+  // Created for each io loop on start, read only then.
+  std::map<EventLoop*, std::shared_ptr<IdleTimeouts>> idleTimeouts_;
 };
 
 }  // namespace net
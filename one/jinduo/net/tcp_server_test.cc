@@ -0,0 +1,176 @@
+// Copyright (c) 2022 Zhang Shuai<zhangshuai.ustc@gmail.com>.
+// All rights reserved.
+//
+// This file is part of ONE.
+//
+// ONE is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// ONE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// ONE. If not, see <https://www.gnu.org/licenses/>.
+
+#include "one/jinduo/net/tcp_server.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "one/jinduo/net/event_loop.h"
+#include "one/jinduo/net/event_loop_thread_pool.h"
+#include "one/jinduo/net/inet_address.h"
+
+using jinduo::net::EventLoop;
+using jinduo::net::InetAddress;
+using jinduo::net::TcpConnection;
+using jinduo::net::TcpServer;
+
+namespace {
+
+using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+
+// Counts the connections from the callbacks in the io loops.
+struct ConnectionCounter {
+  std::mutex mutex;
+  // By the loop serving them.
+  std::map<EventLoop*, int> connected;
+  int up = 0;
+  int down = 0;
+
+  void Watch(TcpServer* server) {
+    server->setConnectionCallback(
+        [this, server](const TcpConnectionPtr& conn) {
+          EXPECT_TRUE(conn->getLoop()->IsInLoopThread());
+          std::lock_guard<std::mutex> lock(mutex);
+          if (conn->connected()) {
+            EXPECT_EQ(conn->getLoop(), server->getLoopOf(conn->id()));
+            ++connected[conn->getLoop()];
+            ++up;
+          } else {
+            ++down;
+          }
+        });
+  }
+
+  int Up() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return up;
+  }
+};
+
+// Blocking connects, they're done by the kernel before being accepted.
+std::vector<int> Connect(const InetAddress& addr, int n) {
+  std::vector<int> fds;
+  for (int i = 0; i < n; ++i) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    EXPECT_EQ(0, ::connect(fd, addr.getSockAddr(), sizeof(sockaddr_in)));
+    fds.push_back(fd);
+  }
+  return fds;
+}
+
+// Runs the loop until all the connections are up, 5 seconds at most.
+void LoopUntilUp(EventLoop* loop, ConnectionCounter* counter, int n) {
+  loop->RunEvery(absl::Milliseconds(1), [=] {
+    if (counter->Up() == n) {
+      loop->Quit();
+    }
+  });
+  loop->RunAfter(absl::Seconds(5), [loop] { loop->Quit(); });
+  loop->Loop();
+}
+
+}  // namespace
+
+TEST(TcpServer, ReusePortPerLoopAcceptsInEachLoop) {
+  constexpr int kConnections = 60;
+  EventLoop loop;
+  auto server = std::make_unique<TcpServer>(
+      &loop, InetAddress(0, true), "shards", TcpServer::kReusePortPerLoop);
+  server->set_thread_num(3);
+  ConnectionCounter counter;
+  counter.Watch(server.get());
+  server->start();
+  // The io loops listen in their own threads.
+  for (EventLoop* ioLoop : server->threadPool()->all_loops()) {
+    std::promise<void> listening;
+    ioLoop->RunInLoop([&] { listening.set_value(); });
+    listening.get_future().wait();
+  }
+  std::vector<int> clients = Connect(server->listenAddress(), kConnections);
+  LoopUntilUp(&loop, &counter, kConnections);
+  EXPECT_EQ(kConnections, counter.up);
+  EXPECT_EQ(kConnections, server->acceptStats().accepted);
+  // Spread over all the io loops by the kernel, none by the base loop.
+  EXPECT_EQ(3U, counter.connected.size());
+  EXPECT_EQ(0U, counter.connected.count(&loop));
+  for (EventLoop* ioLoop : server->threadPool()->all_loops()) {
+    EXPECT_EQ(counter.connected[ioLoop], ioLoop->num_connections());
+  }
+  server.reset();
+  EXPECT_EQ(kConnections, counter.down);
+  for (int fd : clients) {
+    ::close(fd);
+  }
+}
+
+TEST(TcpServer, DestroyWithLiveConnections) {
+  constexpr int kConnections = 20;
+  EventLoop loop;
+  auto server =
+      std::make_unique<TcpServer>(&loop, InetAddress(0, true), "live");
+  server->set_thread_num(3);
+  ConnectionCounter counter;
+  counter.Watch(server.get());
+  server->start();
+  std::vector<int> clients = Connect(server->listenAddress(), kConnections);
+  LoopUntilUp(&loop, &counter, kConnections);
+  EXPECT_EQ(kConnections, counter.up);
+  // Returns once the io loops dropped all the connections.
+  server.reset();
+  EXPECT_EQ(kConnections, counter.down);
+  // Closed by the server.
+  for (int fd : clients) {
+    char c;
+    EXPECT_EQ(0, ::read(fd, &c, 1));
+    ::close(fd);
+  }
+}
+
+TEST(TcpServer, AcceptBudgetLeavesTheRestToLaterIterations) {
+  constexpr int kConnections = 40;
+  constexpr int kBudget = 4;
+  EventLoop loop;
+  auto server =
+      std::make_unique<TcpServer>(&loop, InetAddress(0, true), "budget");
+  server->setAcceptBudget(kBudget);
+  ConnectionCounter counter;
+  counter.Watch(server.get());
+  server->start();
+  // All pending before the loop accepts any.
+  std::vector<int> clients = Connect(server->listenAddress(), kConnections);
+  LoopUntilUp(&loop, &counter, kConnections);
+  EXPECT_EQ(kConnections, counter.up);
+  const jinduo::net::AcceptStats stats = server->acceptStats();
+  EXPECT_EQ(kConnections, stats.accepted);
+  EXPECT_EQ(0U, stats.errors);
+  EXPECT_GE(stats.budget_exhausted, kConnections / kBudget - 1U);
+  // Sampled once the budget ran out, with the rest still queued.
+  EXPECT_GT(stats.max_backlog, 0U);
+  server.reset();
+  for (int fd : clients) {
+    ::close(fd);
+  }
+}